@@ -0,0 +1,27 @@
+#ifndef DISKCACHE_H
+#define DISKCACHE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QSize>
+#include <optional>
+
+// Image cache shared over runs, projects and processes. Figma imageRefs are
+// content hashes, so an entry is valid as long as it exists.
+class DiskCache {
+public:
+    explicit DiskCache(const QString& directory, qint64 maxSize = 1024LL * 1024 * 1024);
+    void setDirectory(const QString& directory);
+    QString directory() const {return m_directory;}
+    std::optional<QByteArray> read(const QString& imageRef, const QSize& maxSize) const;
+    void write(const QString& imageRef, const QSize& maxSize, const QByteArray& bytes);
+private:
+    QString fileName(const QString& imageRef, const QSize& maxSize) const;
+    void evict();
+private:
+    QString m_directory;
+    const qint64 m_maxSize;
+    qint64 m_size = 0;
+};
+
+#endif // DISKCACHE_H
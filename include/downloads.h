@@ -14,6 +14,8 @@ class Downloads : public QObject {
     Q_PROPERTY(qint64 bytesTotal READ bytesTotal NOTIFY bytesTotalChanged)
     Q_PROPERTY(int downloads READ downloads NOTIFY downloadsChanged)
     Q_PROPERTY(bool downloading READ downloading NOTIFY downloadingChanged)
+    Q_PROPERTY(int queued READ queued NOTIFY queueChanged)
+    Q_PROPERTY(int inFlight READ inFlight NOTIFY queueChanged)
 public:
     Downloads(QObject* parent);
     Q_INVOKABLE void cancel();
@@ -24,6 +26,9 @@ public:
     int downloads() const;
     bool downloading() const;
     int activeDownloads() const;
+    int queued() const;
+    int inFlight() const;
+    void setQueue(int queued, int inFlight);
     void monitor(QNetworkReply*, const NetworkFunction& f);
     NetworkFunction monitored(QNetworkReply*);
 signals:
@@ -33,6 +38,7 @@ signals:
     void downloadStart();
     void downloadEnd();
     void downloadingChanged();
+    void queueChanged();
     void cancelled();
     void tooManyRequests();
 private slots:
@@ -42,6 +48,8 @@ private:
     int m_past = 0;
     qint64 m_bytesReceived = 0;
     qint64 m_bytesTotal = 0;
+    int m_queued = 0;
+    int m_inFlight = 0;
 };
 
 #endif // DOWNLOADS_H
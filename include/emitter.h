@@ -0,0 +1,181 @@
+#ifndef EMITTER_H
+#define EMITTER_H
+
+#include <QByteArray>
+#include <QString>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <array>
+#include <cstring>
+#include <algorithm>
+
+// Chunked arena where the parser writes its output. Written bytes never move,
+// hence an Output is just a linked list of pieces in the arena - appending a
+// moved child Output links its pieces in, so neither bytes nor pieces are copied
+// per nesting level, they are joined once when the element is ready.
+class Emitter {
+    static constexpr qsizetype ChunkSize = 64 * 1024;
+    struct Piece {
+        const char* data;
+        qsizetype size;
+        Piece* next;
+    };
+public:
+    class Output {
+    public:
+        Output() = default;
+        Output(const Output& other) : m_emitter(other.m_emitter) {
+            *this += other;
+        }
+        Output(Output&& other) noexcept :
+            m_emitter(other.m_emitter), m_head(other.m_head), m_tail(other.m_tail), m_size(other.m_size) {
+            other.release();
+        }
+        Output& operator=(const Output& other) {
+            if(this != &other) {
+                release();
+                m_emitter = other.m_emitter;
+                *this += other;
+            }
+            return *this;
+        }
+        Output& operator=(Output&& other) noexcept {
+            if(this != &other) {
+                m_emitter = other.m_emitter;
+                m_head = other.m_head;
+                m_tail = other.m_tail;
+                m_size = other.m_size;
+                other.release();
+            }
+            return *this;
+        }
+        Output& operator+=(const QByteArray& bytes) {
+            append(bytes.constData(), bytes.size());
+            return *this;
+        }
+        Output& operator+=(const QString& str) {
+            return *this += str.toUtf8();
+        }
+        Output& operator+=(const char* str) {
+            append(str, static_cast<qsizetype>(std::strlen(str)));
+            return *this;
+        }
+        // pieces are copied, their bytes are not
+        Output& operator+=(const Output& other) {
+            if(!m_emitter)
+                m_emitter = other.m_emitter;
+            const auto last = other.m_tail; // other may be this
+            for(auto piece = other.m_head; piece; piece = piece->next) {
+                add(piece->data, piece->size);
+                if(piece == last)
+                    break;
+            }
+            return *this;
+        }
+        // pieces are linked in as they are
+        Output& operator+=(Output&& other) {
+            if(this == &other || other.isEmpty())
+                return *this;
+            if(!m_emitter)
+                m_emitter = other.m_emitter;
+            if(m_tail)
+                m_tail->next = other.m_head;
+            else
+                m_head = other.m_head;
+            m_tail = other.m_tail;
+            m_size += other.m_size;
+            other.release();
+            return *this;
+        }
+        bool isEmpty() const {
+            return m_size == 0;
+        }
+        qsizetype size() const {
+            return m_size;
+        }
+        QByteArray toByteArray() const {
+            QByteArray bytes;
+            bytes.reserve(m_size);
+            for(auto piece = m_head; piece; piece = piece->next)
+                bytes.append(piece->data, piece->size);
+            return bytes;
+        }
+    private:
+        explicit Output(Emitter* emitter) : m_emitter(emitter) {}
+        void append(const char* data, qsizetype size) {
+            if(size == 0)
+                return;
+            Q_ASSERT(m_emitter);
+            add(m_emitter->write(data, size), size);
+        }
+        void add(const char* data, qsizetype size) { // pieces written one after another are merged
+            m_size += size;
+            if(m_tail && m_tail->data + m_tail->size == data) {
+                m_tail->size += size; // the tail is never shared, a copy has pieces of its own
+                return;
+            }
+            const auto piece = m_emitter->piece(data, size);
+            if(m_tail)
+                m_tail->next = piece;
+            else
+                m_head = piece;
+            m_tail = piece;
+        }
+        void release() {
+            m_head = nullptr;
+            m_tail = nullptr;
+            m_size = 0;
+        }
+    private:
+        Emitter* m_emitter = nullptr;
+        Piece* m_head = nullptr;
+        Piece* m_tail = nullptr;
+        qsizetype m_size = 0;
+        friend class Emitter;
+    };
+public:
+    Emitter() = default;
+    Emitter(const Emitter&) = delete;
+    Emitter& operator=(const Emitter&) = delete;
+
+    Output output() {
+        return Output(this);
+    }
+
+    static QByteArray tabs(int intendents) {
+        static const auto cache = [] {
+            std::array<QByteArray, 32> tabs;
+            for(auto i = 0U; i < tabs.size(); ++i)
+                tabs[i] = QByteArray("    ").repeated(static_cast<int>(i));
+            return tabs;
+        }();
+        Q_ASSERT(intendents >= 0);
+        return static_cast<size_t>(intendents) < cache.size() ? cache[intendents] : QByteArray("    ").repeated(intendents);
+    }
+private:
+    const char* write(const char* data, qsizetype size) {
+        if(size > m_free) {
+            const auto chunkSize = std::max(ChunkSize, size);
+            m_chunks.emplace_back(new char[chunkSize]);
+            m_head = m_chunks.back().get();
+            m_free = chunkSize;
+        }
+        std::memcpy(m_head, data, size);
+        const auto ptr = m_head;
+        m_head += size;
+        m_free -= size;
+        return ptr;
+    }
+    Piece* piece(const char* data, qsizetype size) {
+        m_pieces.push_back({data, size, nullptr});
+        return &m_pieces.back();
+    }
+private:
+    std::vector<std::unique_ptr<char[]>> m_chunks;
+    char* m_head = nullptr;
+    qsizetype m_free = 0;
+    std::deque<Piece> m_pieces; // a deque does not move them
+};
+
+#endif // EMITTER_H
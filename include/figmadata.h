@@ -6,6 +6,9 @@
 #include <QDataStream>
 #include <QMutex>
 #include <tuple>
+#include <functional>
+#include <memory>
+#include <vector>
 
 //TODO: Change to QReadWriteLock - for perf?
 #define MUTEX_LOCK(m) QMutexLocker _l(&m);
@@ -13,11 +16,18 @@
 class FigmaData {
     enum class State {Empty, Pending, Error, Committed};
 public:
+    using Loader = std::function<QByteArray ()>;
+    using EntryFunction = std::function<void (const QString& key, const QString& url, const QByteArray& bytes, int format)>;
     bool contains(const QString& key) const {
         MUTEX_LOCK(m_mutex);
         return m_data.contains(key);
     }
 
+    bool isCommitted(const QString& key) const {
+        MUTEX_LOCK(m_mutex);
+        return m_data.contains(key) && std::get<State>(m_data[key]) == State::Committed;
+    }
+
     bool isEmpty(const QString& key) const {
         MUTEX_LOCK(m_mutex);
         Q_ASSERT(m_data.contains(key));
@@ -31,10 +41,49 @@ public:
     }
 
     QByteArray data(const QString& key) const {
+        std::shared_ptr<Lazy> lazy;
+        {
+            MUTEX_LOCK(m_mutex);
+            Q_ASSERT(std::get<State>(m_data[key]) == State::Committed);
+            Q_ASSERT(m_data.contains(key));
+            const auto loader = m_loaders.find(key);
+            if(loader == m_loaders.end())
+                return std::get<QByteArray>(m_data[key]);
+            lazy = *loader;
+        }
+        return load(key, lazy);
+    }
+
+    // committed entry which bytes are loaded when asked first time
+    void insertLazy(const QString& key, const QString& url, int format, const Loader& loader) {
         MUTEX_LOCK(m_mutex);
-        Q_ASSERT(std::get<State>(m_data[key]) == State::Committed);
-        Q_ASSERT(m_data.contains(key));
-        return std::get<QByteArray>(m_data[key]);
+        m_data.insert(key, {url, {}, format, State::Committed});
+        m_loaders.insert(key, std::make_shared<Lazy>(loader));
+    }
+
+    // loads the lazy entries, e.g. before their file is replaced
+    void load() {
+        QHash<QString, std::shared_ptr<Lazy>> loaders;
+        {
+            MUTEX_LOCK(m_mutex);
+            loaders = m_loaders;
+        }
+        for(auto it = loaders.begin(); it != loaders.end(); ++it)
+            load(it.key(), *it);
+    }
+
+    void forEachCommitted(const EntryFunction& f) const {
+        std::vector<std::tuple<QString, QString, QByteArray, int, std::shared_ptr<Lazy>>> entries;
+        {
+            MUTEX_LOCK(m_mutex);
+            for(auto it = m_data.begin(); it != m_data.end(); ++it) {
+                if(std::get<State>(*it) != State::Committed)
+                    continue;
+                entries.push_back({it.key(), std::get<QString>(*it), std::get<QByteArray>(*it), std::get<int>(*it), m_loaders.value(it.key())});
+            }
+        }
+        for(const auto& [key, url, bytes, format, lazy] : entries)
+            f(key, url, lazy ? load(key, lazy) : bytes, format);
     }
 
     int format(const QString& key) const {
@@ -110,29 +159,16 @@ public:
     }
 
     void clear(){
+        MUTEX_LOCK(m_mutex);
         m_data.clear();
+        m_loaders.clear();
     }
 
     int size() const {
+        MUTEX_LOCK(m_mutex);
         return m_data.size();
     }
 
-    void write(QDataStream& stream) const {
-        const int size = std::accumulate(m_data.begin(), m_data.end(), 0, [](const auto &a, const auto& c){return std::get<State>(c) != State::Committed ? a : a + 1;});
-        stream << size;
-        const auto keys = m_data.keys();
-        for(const auto& key : keys) {
-            if(std::get<State>(m_data[key]) == State::Committed) {
-                stream
-                        << key
-                        << std::get<0>(m_data[key])
-                        << std::get<1>(m_data[key])
-                        << std::get<2>(m_data[key])
-                        << std::get<3>(m_data[key]);
-            }
-        }
-    }
-
     void read(QDataStream& stream) {
         int size;
         stream >> size;
@@ -152,7 +188,38 @@ public:
         }
     }
 private:
-    QHash <QString, std::tuple<QString, QByteArray, int, State> > m_data;
+    // a lazy entry is loaded once and without the table lock, other entries are available meanwhile
+    class Lazy {
+    public:
+        explicit Lazy(const Loader& loader) : m_loader(loader) {}
+        QByteArray bytes() {
+            MUTEX_LOCK(m_mutex);
+            if(m_loader) {
+                m_bytes = m_loader();
+                m_loader = nullptr;
+            }
+            return m_bytes;
+        }
+    private:
+        Loader m_loader;
+        QByteArray m_bytes;
+        QMutex m_mutex;
+    };
+
+    // loaded bytes replace the loader, unless the entry was cleared meanwhile
+    QByteArray load(const QString& key, const std::shared_ptr<Lazy>& lazy) const {
+        const auto bytes = lazy->bytes();
+        MUTEX_LOCK(m_mutex);
+        const auto loader = m_loaders.find(key);
+        if(loader != m_loaders.end() && *loader == lazy) {
+            std::get<QByteArray>(m_data[key]) = bytes;
+            m_loaders.erase(loader);
+        }
+        return bytes;
+    }
+private:
+    mutable QHash <QString, std::tuple<QString, QByteArray, int, State> > m_data; // mutable for lazy loads
+    mutable QHash<QString, std::shared_ptr<Lazy>> m_loaders;
     mutable QMutex m_mutex;
 };
 
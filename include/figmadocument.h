@@ -1,12 +1,12 @@
 #ifndef FIGMADOCUMENT_H
 #define FIGMADOCUMENT_H
 
+#include "qmlserver.h"
 #include <QHash>
 #include <QString>
 #include <QByteArray>
 #include <QJsonObject>
 #include <QJsonDocument>
-#include <QFile>
 #include <vector>
 
 class FigmaDocument {
@@ -131,20 +131,12 @@ enum class DocumentType {
     FileDocument, DataDocument
 };
 
+// View document, the QML is served from memory by the QmlServer
 class FigmaFileDocument : public FigmaDocument {
     class CanvasFile : public FigmaDocument::Canvas {
         class ElementFile : public FigmaDocument::Canvas::Element {
         public:
-            ElementFile(const QString& name, const QString& directory) : m_name(name), m_data((directory + name + ".qml").toLatin1()) {
-            }
-            bool bless(const QByteArray& data) {
-               QFile f(m_data);
-               if(f.exists())
-                   return true;
-               if(!f.open(QIODevice::WriteOnly))
-                   return false;
-               f.write(data);
-               return true;
+            ElementFile(const QString& name, const QString& root) : m_name(name), m_data(QmlServer::url(root, name).toEncoded()) {
             }
             QByteArray data() const override {return m_data;}
             QString name() const override {return m_name;}
@@ -153,29 +145,24 @@ class FigmaFileDocument : public FigmaDocument {
             const QByteArray m_data;
         };
     public:
-        explicit CanvasFile(const QString& name, const QString* directory) : Canvas(name), m_directory(directory) {}
+        explicit CanvasFile(const QString& name, const QString* root) : Canvas(name), m_root(root) {}
         bool addElement(const QString& name, const QByteArray& data) override {
              Q_ASSERT(!name.isEmpty());
              Q_ASSERT(!data.isEmpty());
-             m_elements.push_back(std::make_unique<ElementFile>(name, *m_directory));
-             if(!reinterpret_cast<ElementFile*>(m_elements.back().get())->bless(data))
-                 return false;
+             QmlServer::addFile(*m_root, name, data);
+             m_elements.push_back(std::make_unique<ElementFile>(name, *m_root));
              return true;
          }
     private:
-        const QString* m_directory;
+        const QString* m_root;
     };
 public:
      static DocumentType type() {return DocumentType::FileDocument;}
-     FigmaFileDocument(const QString& directory, const QString& name) : FigmaDocument(name), m_directory(directory) {
+     explicit FigmaFileDocument(const QString& name) : FigmaDocument(name), m_root(QmlServer::addRoot()) {
      }
 
      ~FigmaFileDocument() {
-         for(const auto& c : *this) {
-             for(const auto& e : *c) {
-                 QFile::remove(e->data());
-             }
-         }
+         QmlServer::removeRoot(m_root);
      }
 
      bool containsComponent(const QString& name) const override {
@@ -184,16 +171,16 @@ public:
 
      void addComponent(const QString& name, const QJsonObject& obj, const QByteArray& data) override {
          Q_UNUSED(obj);
-         Q_UNUSED(data);
+         QmlServer::addType(m_root, name, data);
          m_components.insert(name);
      }
 
      Canvas* addCanvas(const QString& canvasName) override  {
-         m_canvas.push_back(std::make_unique<CanvasFile>(canvasName, &m_directory));
+         m_canvas.push_back(std::make_unique<CanvasFile>(canvasName, &m_root));
          return m_canvas.back().get();
      }
 private:
-    const QString m_directory;
+    const QString m_root;
     QSet<QString> m_components;
 };
 
@@ -220,8 +207,7 @@ class FigmaDataDocument : public FigmaDocument {
     };
 public:
     static DocumentType type() {return DocumentType::DataDocument;}
-    FigmaDataDocument(const QString& directory, const QString& name) : FigmaDocument(name) {
-        Q_UNUSED(directory);
+    explicit FigmaDataDocument(const QString& name) : FigmaDocument(name) {
     }
 
     QStringList components(const QString& elementName) const {
@@ -2,6 +2,7 @@
 #define FIGMAGET_H
 
 #include "figmaprovider.h"
+#include "ratelimiter.h"
 #include <QTime>
 #include <QMutex>
 #include <QTimer>
@@ -11,8 +12,12 @@
 
 class FigmaData;
 class Downloads;
+class ImageProcessor;
+class DiskCache;
 class Timeout;
 class Execute;
+class QFile;
+class QFileDevice;
 
 class FigmaGet : public FigmaProvider {
     Q_OBJECT
@@ -20,6 +25,8 @@ class FigmaGet : public FigmaProvider {
     Q_PROPERTY(QString userToken MEMBER m_userToken NOTIFY userTokenChanged)
     Q_PROPERTY(QString projectToken MEMBER m_projectToken NOTIFY projectTokenChanged)
     Q_PROPERTY(int throttle MEMBER m_throttle NOTIFY throttleChanged)
+    Q_PROPERTY(int concurrency MEMBER m_concurrency NOTIFY concurrencyChanged)
+    Q_PROPERTY(QString imageCache MEMBER m_imageCache NOTIFY imageCacheChanged)
     using NetworkFunction = std::function <QNetworkReply* ()>;
 public:
     explicit FigmaGet(QObject *parent = nullptr);
@@ -31,6 +38,7 @@ public:
                                                                      std::numeric_limits<int>::max())) override;
     void getRendering(const QString& figmaId) override;
     void getNode(const QString& figmaId) override;
+    void prefetch(const QStringList& imageRefs, const QStringList& figmaIds, const QStringList& nodeIds, const QSize& maxSize) override;
     QByteArray data() const;
 
     Downloads* downloadProgress();
@@ -59,6 +67,8 @@ signals:
     void userTokenChanged();
     void updateCompleted(bool isUpdated);
     void throttleChanged();
+    void concurrencyChanged();
+    void imageCacheChanged();
     void restored(unsigned flags, const QVariantMap& imports);
     void replyComplete(const std::shared_ptr<QByteArray>& bytes);
 private:
@@ -68,12 +78,23 @@ private:
         const QString id; const IdType type;
     };
     using FinishedFunction = std::function<void ()>;
+    enum class Lane {Api, Download};
+    struct CallLane {
+        QQueue<NetworkFunction> calls;
+        int inFlight = 0;
+    };
     void monitorReply(QNetworkReply* reply, const std::shared_ptr<QByteArray>& bytes,
                       const FinishedFunction& finalize, bool showProgress = true);
-    void queueCall(const NetworkFunction& call);
+    void queueCall(const NetworkFunction& call, Lane lane);
+    bool startCall(CallLane& lane);
+    void doDownloads();
+    void updateQueue();
+    void rateLimit(const QNetworkReply* reply);
+    static Lane laneOf(const QUrl& url);
     QByteArray image(const Id& imageRef, const QByteArray& imageData) const;
-    bool write(QDataStream& stream, unsigned flag, const QVariantMap& imports) const;
-    bool read(QDataStream& stream);
+    bool write(QFileDevice& file, unsigned flag, const QVariantMap& imports) const;
+    bool read(QDataStream& stream, const std::shared_ptr<QFile>& file);
+    bool readLegacy(QDataStream& stream);
 private slots:
      void replyCompleted(const std::shared_ptr<QByteArray>& bytes);
      void doCall();
@@ -84,9 +105,12 @@ private slots:
      void onRetrievedNode(const QString& nodeId);
 private:
     QNetworkReply* populateImages();
-    QNetworkReply* doRequestRendering(const Id& id);
-    void doRetrieveNode(const Id& id);
+    QNetworkReply* doRequestRendering(const QStringList& ids);
+    QString renderingUrl(const QStringList& ids) const;
+    QNetworkReply* doRetrieveNodes(const QStringList& ids);
+    QString nodeUrl(const QStringList& ids) const;
     QNetworkReply* doRetrieveImage(const Id& id,  FigmaData* target, const QSize& maxSize);
+    bool fromDiskCache(const QString& imageRef, const QSize& maxSize);
     void retrieveImage(const Id& id,  FigmaData* target, const QSize& maxSize = QSize(std::numeric_limits<int>::max(), std::numeric_limits<int>::max()));
     void requestRendering(const Id& imageId);
     void retrieveNode(const Id& id);
@@ -99,6 +123,10 @@ private:
     Timeout* m_timeout;
     Execute* m_error;
     Downloads* m_downloads;
+    ImageProcessor* m_imageProcessor;
+    QString m_imageCache;
+    QString m_restoredFile;
+    std::unique_ptr<DiskCache> m_diskCache;
     QString m_projectToken;
     QString m_userToken;
     QByteArray m_data;
@@ -108,9 +136,15 @@ private:
     std::unique_ptr<FigmaData> m_nodes;
     std::atomic_bool m_populationOngoing = false;
     int m_throttle = 300; //Idea of throttle is collect requests into queue and bunches to reduce especially renderig requests
-    QQueue<NetworkFunction> m_callQueue;
+    int m_concurrency = 8; // images are downloaded from CDN, only bandwidth limits them
+    RateLimiter m_rateLimiter{1000. / m_throttle};
+    Backoff m_downloadBackoff; // CDN 429s do not hold the API calls
+    CallLane m_apiCalls;
+    CallLane m_downloadCalls;
     QTimer m_callTimer;
     QStringList m_rendringQueue;
+    QStringList m_nodeQueue;
+    int m_renderingBatch = 50;
     State m_connectionState = State::Loading;
     QMap<QNetworkReply*, std::tuple<std::shared_ptr<QByteArray>, FinishedFunction>> m_replies;
     std::function<void (const QString&)> m_lastError = nullptr;
@@ -3,6 +3,7 @@
 
 #include "figmaprovider.h"
 #include "orderedmap.h"
+#include "emitter.h"
 #include <QJsonDocument>
 #include <QRegularExpression>
 #include <QJsonArray>
@@ -79,8 +80,38 @@ public:
         const QString m_description;
         const QJsonObject m_object;
     };
+    // id and type lookups of a document, built once when the JSON is loaded. Nodes are
+    // kept in depth first order, so that a subtree is a range of positions, and the
+    // hashes refer to positions. A QJsonObject shares the document data, it is not a copy.
+    class Index {
+    public:
+        explicit Index(const QJsonObject& document);
+        Index() {}
+        QJsonObject object(const QString& id) const {
+            const auto pos = m_positions.constFind(id);
+            return pos != m_positions.constEnd() ? m_nodes[*pos] : QJsonObject();
+        }
+        bool contains(const QString& id) const {return m_positions.contains(id);}
+        std::vector<QJsonObject> objects(const QString& type, const QString& subtree) const;
+        // hash of the whole subtree of a node, empty if not in the index
+        QByteArray digest(const QString& id) const {
+            const auto pos = m_positions.constFind(id);
+            return pos != m_positions.constEnd() ? m_digests[*pos] : QByteArray();
+        }
+    private:
+        std::vector<QJsonObject> m_nodes;
+        std::vector<int> m_ends; // position after the subtree of a node
+        std::vector<QByteArray> m_digests;
+        QHash<QString, int> m_positions;
+        QHash<QString, std::vector<int>> m_types; // positions in ascending order
+    };
     using Components = QHash<QString, std::shared_ptr<Component>>;
     using Canvases = std::vector<Canvas>;
+    struct Resources {
+        QSet<QString> images;
+        QSet<QString> renderings;
+        QSet<QString> nodes;
+    };
 
 public:
     inline static const QString PlaceHolder = "placeholder";
@@ -94,27 +125,31 @@ public:
         BreakBooleans = 1024,
         AntializeShapes = 2048
     };
-    using EByteArray = std::optional<QByteArray>;
+    using Output = Emitter::Output;
+    using EByteArray = std::optional<Output>;
 public:
-    static std::optional<Components> components(const QJsonObject& project,  FigmaParserData& data);
+    static std::optional<Components> components(const QJsonObject& project, const Index& index, FigmaParserData& data);
     static std::optional<Canvases> canvases(const QJsonObject& project, FigmaParserData& data);
-    static std::optional<Element> component(const QJsonObject& obj, unsigned flags,  FigmaParserData& data, const Components& components);
-    static std::optional<Element> element(const QJsonObject& obj, unsigned flags,  FigmaParserData& data, const Components& components);
+    static std::optional<Element> component(const QJsonObject& obj, unsigned flags,  FigmaParserData& data, const Components& components, const Index& index);
+    static std::optional<Element> element(const QJsonObject& obj, unsigned flags,  FigmaParserData& data, const Components& components, const Index& index);
+    static void extractRepeated(const QJsonObject& document, Components& components);
+    static Resources resources(const QJsonObject& project, const Index& index, const std::vector<QJsonObject>& elements, unsigned flags, FigmaParserData& data);
     static QString name(const QJsonObject& project);
     static QString lastError();
     static QString makeFileName(const QString& itemName);
 private:
     enum class StrokeType {Normal, Double, OnePix};
     enum class ItemType {None, Vector, Text, Frame, Component, Boolean, Instance};
+    enum class NodeType {Vector, Text, Component, Boolean, Instance, Frame, Skip, Plain};
 private:
     static QString validFileName(const QString& itemName, bool inited);
-    static QHash<QString, QJsonObject> getObjectsByType(const QJsonObject& obj, const QString& type);
     static QJsonObject delta(const QJsonObject& instance, const QJsonObject& base,
                              const QSet<QString>& ignored,
                              const QHash<QString, std::function<QJsonValue (const QJsonValue&, const QJsonValue&)>>& compares);
     static QHash<QString, QString> children(const QJsonObject& obj);
     std::optional<Element> getElement(const QJsonObject& obj);
-    QString tabs(int intendents) const;
+    QByteArray tabs(int intendents) const;
+    Output output(const QByteArray& bytes = QByteArray());
 #if 0
     QRectF boundingRect(const QJsonObject& obj);
     QRectF boundingRect(const QString& svgPath, const QSizeF& size) const;
@@ -175,9 +210,11 @@ private:
 
      bool isRendering(const QJsonObject& obj) const;
 
+     void collectResources(const QJsonObject& obj, Resources& resources) const;
+
     EByteArray parseText(const QJsonObject& obj, int intendents);
 
-     QByteArray parseSkip(const QJsonObject& obj, int intendents);
+     EByteArray parseSkip(const QJsonObject& obj, int intendents);
 
      EByteArray parseFrame(const QJsonObject& obj, int intendents);
 
@@ -195,12 +232,15 @@ private:
      EByteArray parseRendered(const QJsonObject& obj, int intendents);
 
      EByteArray makeInstanceChildren(const QJsonObject& obj, const QJsonObject& comp, int intendents);
+     EByteArray parseRepeated(const QJsonObject& obj, const Component& comp, int intendents);
      QJsonValue getValue(const QJsonObject& obj, const QString& key) const;
 
      EByteArray parseInstance(const QJsonObject& obj, int intendents);
      EByteArray parseChildren(const QJsonObject& obj, int intendents);
 
-     std::optional<OrderedMap<QString, QByteArray>> parseChildrenItems(const QJsonObject& obj, int intendents);
+     std::optional<OrderedMap<QString, Output>> parseChildrenItems(const QJsonObject& obj, int intendents);
+     static int subtreeSizes(const QJsonObject& obj, QHash<QString, int>& sizes);
+     void collectComponentIds(const QJsonObject& obj);
 
      EByteArray parseBooleanOperationUnion(const QJsonObject& obj, int intendents, const QString& sourceId, const QString& maskSourceId);
      EByteArray parseBooleanOperationSubtract(const QJsonObject& obj, const QJsonArray& children, int intendents, const QString& sourceId, const QString& maskSourceId);
@@ -210,17 +250,21 @@ private:
 
 private:
 
-    FigmaParser(unsigned flags, FigmaParserData& data, const Components* components);
+    FigmaParser(unsigned flags, FigmaParserData& data, const Components* components, const Index* index);
 
     const unsigned m_flags;
     FigmaParserData& m_data;
     const Components* m_components;
-    const QString m_intendent = "    ";
+    const Index* m_index;
+    Emitter m_emitter;
     QSet<QString> m_componentIds;
     const QJsonObject* m_parent;
+    std::shared_ptr<const QHash<QString, int>> m_subtreeSizes; // only the subtrees that are forked
 
     static QByteArray fontWeight(double v);
     static std::optional<FigmaParser::ItemType> type(const QJsonObject& obj);
+    static std::optional<NodeType> nodeType(const QJsonObject& obj);
+    friend class BenchDispatch;
 };
 
 #endif // FIGMAPARSER_H
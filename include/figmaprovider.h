@@ -3,6 +3,7 @@
 
 #include <QObject>
 #include <QSize>
+#include <QStringList>
 #include <limits>
 
 class FigmaProvider : public QObject {
@@ -18,6 +19,7 @@ public:
                                                                      std::numeric_limits<int>::max())) = 0;
     virtual void getRendering(const QString& figmaId) = 0;
     virtual void getNode(const QString& figmaId) = 0;
+    virtual void prefetch(const QStringList& imageRefs, const QStringList& figmaIds, const QStringList& nodeIds, const QSize& maxSize) = 0;
     virtual std::tuple<int, int, int> cacheInfo() const = 0;
 signals:
     void imageReady(const QString& imageRef, const QByteArray& bytes, int format);
@@ -10,10 +10,13 @@
 #include <QVector>
 #include <memory>
 #include <optional>
+#include <deque>
+#include <set>
 
 class FigmaFileDocument;
 class FigmaDataDocument;
 class FontCache;
+class QIODevice;
 
 
 class FigmaQml : public QObject, public FigmaParserData {
@@ -48,7 +51,9 @@ public:
         EmbedImages         = 0x80,
         Timed               = 0x100,
         AltFontMatch        = 0x200,
-        KeepFigmaFontName   = 0x400
+        KeepFigmaFontName   = 0x400,
+        ExtractRepeated     = 0x1000,
+        ResourceImages      = 0x2000
     };
     Q_ENUM(Flags)
 public:
@@ -81,6 +86,7 @@ public:
     void restore(int flags, const QVariantMap& imports);
     QString documentsLocation() const;
     Q_INVOKABLE bool saveAllQML(const QString& folderName);
+    Q_INVOKABLE bool saveAllQMLZip(const QString& zipName);
     Q_INVOKABLE void cancel();
     Q_INVOKABLE static QString validFileName(const QString& name);
     Q_INVOKABLE QByteArray componentSourceCode(const QString& name) const;
@@ -144,17 +150,39 @@ signals:
 private slots:
     void doCancel();
 private:
+    enum class Resource {Image, Rendering, Node};
+    using Resources = std::set<std::pair<QString, Resource>>; // what a parse asked from the provider
     void addImageFile(const QString& imageRef, bool isRendering);
     bool addImageFileData(const QString& imageRef, const QByteArray& bytes, int mime, bool isRendering);
+    bool imageSource(const QString& imageRef, bool isRendering, QByteArray& out);
+    std::optional<QByteArray> resolveImages(const QByteArray& data);
     bool ensureDirExists(const QString& dirname);
-    bool saveImages(const QString &folder);
+    struct ExportFile;
+    bool exportList(std::vector<ExportFile>& files);
+    bool exportFiles(std::vector<ExportFile>& files, const QString& folder);
+#ifdef HAS_QUAZIP
+    bool writeZip(QIODevice& device, const QString& zipName);
+#endif
     bool doCreateDocument(FigmaDocument& doc, const QJsonObject& json);
+    bool parseComponents(const FigmaParser::Components& components);
+    bool parseElements(const FigmaParser::Canvases& canvases, const FigmaParser::Components& components);
+    bool isFiltered(int canvas, int element) const;
+    struct Parsed;
     template<class FigmaDocType>
-    void createDocument(const QJsonObject& json);
-    std::optional<QJsonObject> object(const QByteArray& bytes);
-    void cleanDir(const QString& dirName);
+    void createDocument(const std::shared_ptr<const Parsed>& parsed);
+    std::shared_ptr<const Parsed> object(const QByteArray& bytes);
     std::optional<std::tuple<QByteArray, int>> getImage(const QString& imageRef, bool isRendering);
+    void requestImage(const QString& imageRef, bool isRendering);
+    std::optional<QByteArray> imageReference(const QString& imageRef, bool isRendering);
     void suspend();
+    class ParseTask;
+    bool runParseTasks(std::deque<ParseTask>& tasks);
+    QByteArray objectDigest(const QJsonObject& obj) const;
+    QByteArray cacheKey(const QJsonObject& obj, const QString& componentName = QString()) const;
+    QByteArray componentDigest(const FigmaParser::Components& components, const QString& id);
+    std::optional<FigmaParser::Element> cached(const QByteArray& key, const FigmaParser::Components& components);
+    void cache(const QByteArray& key, const FigmaParser::Element& element, const FigmaParser::Components& components, const Resources& resources);
+    void pruneCache();
     bool writeComponents(FigmaDocument& doc, const FigmaParser::Components& components, const QByteArray& header);
     bool setDocument(FigmaDocument& doc, const FigmaParser::Canvases& canvases, const FigmaParser::Components& components, const QByteArray& header);
 private:
@@ -168,7 +196,12 @@ private:
     unsigned m_flags = 0;
     QByteArray m_brokenPlaceholder;
     QMap<int, QSet<int>> m_filter;
-    QHash<QString, QPair<QString, QString>> m_imageFiles;
+    struct ImageFile {
+        QString path;
+        QString name;
+        bool isRendering;
+    };
+    QHash<QString, ImageFile> m_imageFiles;
     QString m_snap;
     std::unique_ptr<FontCache> m_fontCache;
     QString m_fontFolder;
@@ -178,6 +211,12 @@ private:
     bool m_embedImages = false;
     enum class State {Constructing, Failed, Suspend};
     State m_state = State::Constructing;
+    struct Build;
+    std::unique_ptr<Build> m_build;
+    std::unique_ptr<Build> m_lastBuild;
+    std::shared_ptr<const Parsed> m_parsed;
+    struct ParseCache;
+    std::unique_ptr<ParseCache> m_parseCache;
     std::function<void (bool)> mRestore = nullptr;
 };
 
@@ -0,0 +1,33 @@
+#ifndef IMAGEPROCESSOR_H
+#define IMAGEPROCESSOR_H
+
+#include <QObject>
+#include <QSize>
+#include <QThreadPool>
+#include <functional>
+#include <atomic>
+
+// Sniffs, decodes, scales and encodes downloaded images on worker threads
+class ImageProcessor : public QObject {
+    Q_OBJECT
+public:
+    struct Image {
+        QByteArray bytes;
+        QByteArray format;
+        QString error;
+    };
+    using ReadyFunction = std::function<void (const Image&)>;
+public:
+    explicit ImageProcessor(QObject* parent = nullptr);
+    ~ImageProcessor();
+    // ready is called in the thread of this object
+    void process(const QByteArray& bytes, const QSize& maxSize, const ReadyFunction& ready);
+    int pending() const {return m_pending;}
+private:
+    static Image processImage(QByteArray bytes, const QSize& maxSize);
+private:
+    QThreadPool m_pool;
+    std::atomic_int m_pending = 0;
+};
+
+#endif // IMAGEPROCESSOR_H
@@ -11,6 +11,9 @@ public:
     const V& operator[](const K& k) const {
         return m_data[m_index[k]].second;
     }
+    V& operator[](const K& k) {
+        return m_data[m_index[k]].second;
+    }
     auto keys() const {
         QStringList lst;
         std::transform(m_data.begin(), m_data.end(), std::back_inserter(lst), [](const auto& p){return p.first;});
@@ -20,6 +23,10 @@ public:
         m_index.insert(k, m_data.size());
         m_data.append({k, v});
     }
+    void insert(const K& k, V&& v) {
+        m_index.insert(k, m_data.size());
+        m_data.append({k, std::move(v)});
+    }
     auto size() const {
         return m_index.size();
     }
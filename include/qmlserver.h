@@ -0,0 +1,30 @@
+#ifndef QMLSERVER_H
+#define QMLSERVER_H
+
+#include <QString>
+#include <QByteArray>
+#include <QUrl>
+#include <QQmlNetworkAccessManagerFactory>
+#include <optional>
+
+// Serves the view documents to the QML engine from memory. Each document
+// owns a root, its elements and components are loaded from
+// figmaqml://<root>/<name>.qml and the components are listed in a generated
+// qmldir, as the engine cannot scan a remote directory for types.
+class QmlServer {
+public:
+    static constexpr auto Scheme = "figmaqml";
+    class Factory : public QQmlNetworkAccessManagerFactory {
+    public:
+        QNetworkAccessManager* create(QObject* parent) override;
+    };
+public:
+    static QString addRoot();
+    static void removeRoot(const QString& root);
+    static void addFile(const QString& root, const QString& name, const QByteArray& data);
+    static void addType(const QString& root, const QString& name, const QByteArray& data);
+    static QUrl url(const QString& root, const QString& name);
+    static std::optional<QByteArray> file(const QUrl& url);
+};
+
+#endif // QMLSERVER_H
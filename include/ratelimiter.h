@@ -0,0 +1,110 @@
+#ifndef RATELIMITER_H
+#define RATELIMITER_H
+
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <algorithm>
+
+// Exponential backoff with jitter: a 429 pauses for what the server asks,
+// or for a pause that doubles on each 429 in a row.
+class Backoff {
+    static constexpr qint64 InitialBackoff = 2000;
+    static constexpr qint64 MaxBackoff = 60 * 1000;
+public:
+    Backoff() {
+        m_clock.start();
+    }
+
+    // retryAfter is in ms, negative if the server did not tell, returns the pause in ms
+    qint64 tooManyRequests(qint64 retryAfter) {
+        m_backoff = m_backoff == 0 ? InitialBackoff : std::min(MaxBackoff, m_backoff * 2);
+        return pause(retryAfter >= 0 ? retryAfter : m_backoff);
+    }
+
+    void success() {
+        m_backoff = 0;
+    }
+
+    qint64 pause(qint64 ms) {
+        const auto wait = ms + QRandomGenerator::global()->bounded(ms / 4 + 1); // jitter spreads the retries
+        m_pausedUntil = std::max(m_pausedUntil, m_clock.elapsed() + wait);
+        return wait;
+    }
+
+    // ms until calls can be started again
+    qint64 remaining() const {
+        return std::max<qint64>(0, m_pausedUntil - m_clock.elapsed());
+    }
+private:
+    qint64 m_backoff = 0;
+    qint64 m_pausedUntil = 0;
+    QElapsedTimer m_clock;
+};
+
+// Token bucket that adapts to the server: a 429 halves the rate and pauses
+// all calls, rate limit headers cap the rate and successful calls ramp it back up.
+class RateLimiter {
+    static constexpr double MinRate = 0.05; // calls per second
+    static constexpr double RateStep = 0.1;
+public:
+    explicit RateLimiter(double maxRate, double burst = 3.) :
+        m_maxRate(maxRate), m_rate(maxRate), m_burst(burst), m_tokens(burst) {
+        m_clock.start();
+    }
+
+    void setMaxRate(double maxRate) {
+        m_maxRate = std::max(MinRate, maxRate);
+        m_rate = std::min(m_rate, m_maxRate);
+    }
+
+    double rate() const {
+        return m_rate;
+    }
+
+    // consumes a token if a call can be started now
+    bool tryAcquire() {
+        if(m_backoff.remaining() > 0)
+            return false;
+        const auto now = m_clock.elapsed();
+        m_tokens = std::min(m_burst, m_tokens + (now - m_lastRefill) * m_rate / 1000.);
+        m_lastRefill = now;
+        if(m_tokens < 1.)
+            return false;
+        m_tokens -= 1.;
+        return true;
+    }
+
+    void success() {
+        m_backoff.success();
+        m_rate = std::min(m_maxRate, m_rate + RateStep);
+    }
+
+    // retryAfter is in ms, negative if the server did not tell, returns the pause in ms
+    qint64 tooManyRequests(qint64 retryAfter) {
+        m_rate = std::max(MinRate, m_rate / 2.);
+        m_tokens = 0;
+        return m_backoff.tooManyRequests(retryAfter);
+    }
+
+    // remaining calls allowed until the window resets after resetMs
+    void limit(int remaining, qint64 resetMs) {
+        if(resetMs <= 0)
+            return;
+        if(remaining <= 0) {
+            m_tokens = 0;
+            m_backoff.pause(resetMs);
+        } else {
+            m_rate = std::clamp(remaining * 1000. / resetMs, MinRate, m_maxRate);
+        }
+    }
+private:
+    double m_maxRate;
+    double m_rate;
+    const double m_burst;
+    double m_tokens;
+    qint64 m_lastRefill = 0;
+    Backoff m_backoff;
+    QElapsedTimer m_clock;
+};
+
+#endif // RATELIMITER_H
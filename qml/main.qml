@@ -42,16 +42,17 @@ ApplicationWindow {
 
     }
 
-    function sourceCodeError(error, container) {
-        let item = null;
-        try {
-            item = Qt.createQmlObject(figmaQml.sourceCode, container, figmaQml.element)
-        } catch(err) {
-            return err;
-        }
-        if(item)
-            item.destroy();
-        return error;
+    // the errors of a component in the form of a createQmlObject exception. The component is
+    // loaded from its figmaqml:// url, hence the lines refer to the served document
+    function componentError(comp) {
+        const qmlErrors = [];
+        const lines = comp.errorString().split('\n');
+        for (let i = 0; i < lines.length; i++) {
+            const m = lines[i].match(/^(.*):(-?\d+) (.*)$/);
+            if(m)
+                qmlErrors.push({fileName: m[1], lineNumber: m[2], columnNumber: "-", message: m[3]});
+        }
+        return qmlErrors.length > 0 ? {qmlErrors: qmlErrors} : comp.errorString();
     }
 
     function fileName(filename) {
@@ -185,6 +186,11 @@ ApplicationWindow {
                 text: "Export all QMLs..."
                 onTriggered: saveAllQMLs();
             }
+            MenuItem {
+                enabled: figmaQml && figmaQml.isValid && !isWebAssembly && hasZipExport
+                text: "Export all QMLs as zip..."
+                onTriggered: zipAllDialog.open();
+            }
             MenuItem {
                 text: "Edit imports..."
                 onTriggered: imports.open();
@@ -304,6 +310,16 @@ ApplicationWindow {
                                     figmaQml.flags &= ~FigmaQml.EmbedImages
                             }
                         }
+                        QtCheckBox {
+                            text: "Resource images"
+                            checked: figmaQml.flags & FigmaQml.ResourceImages
+                            onCheckedChanged: {
+                                if(checked)
+                                    figmaQml.flags |= FigmaQml.ResourceImages
+                                else
+                                    figmaQml.flags &= ~FigmaQml.ResourceImages
+                            }
+                        }
                         Repeater {
                             model:  [
                                /* {"Shapes":  FigmaQml.PrerenderShapes},
@@ -539,26 +555,62 @@ ApplicationWindow {
                     figmaview.scale = Qt.binding(()=>zoomSlider.value);
                 }
 
+                function showError(error) {
+                    let errors = "Text {text:\"Error loading figma item\";}\n"
+
+                    console.debug("Catch error on create:", error)
+
+                    if(error.qmlErrors) {
+                        for (let i = 0; i < error.qmlErrors.length; i++) {
+                            errors += "Column {\nText {text:\"" + "line: "
+                                    + error.qmlErrors[i].lineNumber  + "\";}\n"
+                                    + "Text {text:\"column: "
+                                    + error.qmlErrors[i].columnNumber + "\";}\n"
+                                    + "Text {text:\"file: "
+                                    + fileName(error.qmlErrors[i].fileName) + "\";}\n"
+                                    + "Text {text:'message: "
+                                    + error.qmlErrors[i].message.split('').map(c=>'\\x' + c.charCodeAt(0).toString(16)).join('') + "';}\n}\n"
+                        }
+                    } else {
+                       errors += "Text {text: \"Unknown error:" + String(error).replace(/"/g, '\\"') +"\" }";
+                    }
+                    let content = "import QtQuick 2.14\n Column {\n" + errors + "}\n";
+                    try {
+                    figmaview = Qt.createQmlObject(
+                                content,
+                                container, "Debug info");
+                    } catch (error) {
+                        print ("Error loading QML : ")
+                        for (let i = 0; i < error.qmlErrors.length; i++) {
+                            print("lineNumber: " + error.qmlErrors[i].lineNumber)
+                            print("columnNumber: " + error.qmlErrors[i].columnNumber)
+                            print("content: " + content)
+                            print("message: " + error.qmlErrors[i].message)
+                        }
+                    }
+                    updater.stop();
+                }
+
                 function create() {
                     if (figmaview) {
                         figmaview.destroy()
                     }
-                   /* const source =  "import \"file:///"
-                                 + figmaQml.qmlDir
-                                 + "/qml\"\n\n"
-                                 + figmaQml.element; */
                     let comp = null;
                     try {
-                        comp = Qt.createComponent(figmaQml.element);
+                        // figmaqml:// is remote to the engine, hence the component may load asynchronously
+                        comp = Qt.createComponent(figmaQml.element, Component.Asynchronous);
                         if(comp) {
                             const ctor = function() {
                                 if (comp.status === Component.Ready) {
+                                   comp.statusChanged.disconnect(ctor);
                                    figmaview = comp.createObject(container);
                                    figmaQml.componentLoaded(figmaQml.currentCanvas, figmaQml.currentElement);
                                    return true;
                                 }
                                 if (comp.status === Component.Error) {
-                                    throw(comp.errorString());
+                                    comp.statusChanged.disconnect(ctor);
+                                    showError(componentError(comp));
+                                    return true;
                                 }
                                 return false;
                             }
@@ -568,45 +620,7 @@ ApplicationWindow {
                             errorNote.text = "Cannot create component \"" + figmaQml.element + "\"";
                         }
                     } catch (error) {
-                        //There is a reason line numbers wont match, and therefore we try to load a sourceCode
-                        error = sourceCodeError(error, container);
-                        let errors = "Text {text:\"Error loading figma item\";}\n"
-
-                        console.debug("Catch error on create:", error)
-
-                        if(error.qmlErrors) {
-                            for (let i = 0; i < error.qmlErrors.length; i++) {
-                                errors += "Column {\nText {text:\"" + "line: "
-                                        + error.qmlErrors[i].lineNumber  + "\";}\n"
-                                        + "Text {text:\"column: "
-                                        + error.qmlErrors[i].columnNumber + "\";}\n"
-                                        + "Text {text:\"file: "
-                                        + fileName(error.qmlErrors[i].fileName) + "\";}\n"
-                                        + "Text {text:'message: "
-                                        + error.qmlErrors[i].message.split('').map(c=>'\\x' + c.charCodeAt(0).toString(16)).join('') + "';}\n}\n"
-                            }
-                        } else {
-                           errors += "Text {text: \"Unknown error:" + error.replace(/"/g, '\\"') +"\" }";
-                        }
-                        let content = "import QtQuick 2.14\n Column {\n" + errors + "}\n";
-                        try {
-                        figmaview = Qt.createQmlObject(
-                                    content,
-                                    container, "Debug info");
-                        } catch (error) {
-                            print ("Error loading QML : ")
-                            for (let i = 0; i < error.qmlErrors.length; i++) {
-                                print("lineNumber: " + error.qmlErrors[i].lineNumber)
-                                print("columnNumber: " + error.qmlErrors[i].columnNumber)
-                                print("content: " + content)
-                                print("message: " + error.qmlErrors[i].message)
-                            }
-                        }
-                        updater.stop();
-                        if(typeof source !== 'undefined')
-                            console.log(source); //throw out the code
-                        else
-                            console.debug("Source not created")
+                        showError(error);
                     }
                 }
             }
@@ -651,6 +665,9 @@ ApplicationWindow {
             Label {
                 text: figmaDownload ? ("Downloads: " + figmaDownload.downloads): "__"
             }
+            Label {
+                text: figmaDownload ? ("Queued: " + figmaDownload.queued + " / " + figmaDownload.inFlight): "__"
+            }
             Text {
                 text: documentName
             }
@@ -946,6 +963,24 @@ ApplicationWindow {
         }
     }
 
+    FileDialog {
+        id: zipAllDialog
+        title: "Export All QMLs as zip"
+        property string name: figmaQml.validFileName(documentName) + "_" + figmaQml.validFileName(canvasName) + ".zip"
+        currentFile: "file:///" + encodeURIComponent(name)
+        currentFolder: figmaQml.documentsLocation
+        nameFilters: [ "Zip files (*.zip)", "All files (*)" ]
+        fileMode: FileDialog.SaveFile
+        onAccepted: {
+            let path = zipAllDialog.currentFile.toString();
+            path = path.replace(/^(file:\/\/)/,"");
+            path = path.replace(/^(\/(c|C):\/)/, "C:/");
+            if(!figmaQml.saveAllQMLZip(path)) {
+                errorNote.text = "Cannot save to \"" + path + "\""
+            }
+        }
+    }
+
     FolderDialog {
         id: fontFolderDialog
         title: "Add font search folder"
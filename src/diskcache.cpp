@@ -0,0 +1,79 @@
+#include "diskcache.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QLockFile>
+#include <QDateTime>
+#include <QCryptographicHash>
+
+constexpr auto LockName = ".lock";
+
+DiskCache::DiskCache(const QString& directory, qint64 maxSize) : m_maxSize(maxSize) {
+    setDirectory(directory);
+}
+
+void DiskCache::setDirectory(const QString& directory) {
+    m_directory = directory;
+    m_size = 0;
+    if(m_directory.isEmpty() || !QDir().mkpath(m_directory)) {
+        m_directory.clear(); // cache is disabled
+        return;
+    }
+    const auto entries = QDir(m_directory).entryInfoList(QDir::Files);
+    for(const auto& e : entries)
+        m_size += e.size();
+}
+
+QString DiskCache::fileName(const QString& imageRef, const QSize& maxSize) const {
+    const auto key = QString("%1_%2x%3").arg(imageRef).arg(maxSize.width()).arg(maxSize.height());
+    return m_directory + '/' + QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex();
+}
+
+std::optional<QByteArray> DiskCache::read(const QString& imageRef, const QSize& maxSize) const {
+    if(m_directory.isEmpty())
+        return std::nullopt;
+    QFile file(fileName(imageRef, maxSize));
+    if(!file.open(QIODevice::ReadOnly)) // not there or just evicted by other process
+        return std::nullopt;
+    auto bytes = file.readAll();
+    if(bytes.isEmpty())
+        return std::nullopt;
+    file.close();
+    // LRU age, Windows sets file times only through a writable handle, appending keeps the content
+    QFile touch(file.fileName());
+    if(touch.open(QIODevice::Append))
+        touch.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+    return bytes;
+}
+
+void DiskCache::write(const QString& imageRef, const QSize& maxSize, const QByteArray& bytes) {
+    if(m_directory.isEmpty())
+        return;
+    // written aside and renamed, hence readers never see a partial file
+    QSaveFile file(fileName(imageRef, maxSize));
+    const QFileInfo replaced(file.fileName());
+    const auto replacedSize = replaced.exists() ? replaced.size() : 0;
+    if(!file.open(QIODevice::WriteOnly) || file.write(bytes) != bytes.size() || !file.commit())
+        return;
+    m_size += bytes.size() - replacedSize;
+    if(m_size > m_maxSize)
+        evict();
+}
+
+// oldest entries are removed until the cache is 3/4 of its maximum, other processes share the same directory
+void DiskCache::evict() {
+    QLockFile lock(m_directory + '/' + LockName);
+    if(!lock.tryLock(0))
+        return; // someone else is evicting
+    auto entries = QDir(m_directory).entryInfoList(QDir::Files, QDir::Time | QDir::Reversed);
+    m_size = 0;
+    for(const auto& e : entries)
+        m_size += e.size();
+    for(const auto& e : entries) {
+        if(m_size <= m_maxSize * 3 / 4)
+            break;
+        if(e.fileName() != LockName && QFile::remove(e.absoluteFilePath()))
+            m_size -= e.size();
+    }
+}
@@ -114,3 +114,19 @@ int Downloads::downloads() const {
 int Downloads::activeDownloads() const {
     return m_progresses.size();
 }
+
+int Downloads::queued() const {
+    return m_queued;
+}
+
+int Downloads::inFlight() const {
+    return m_inFlight;
+}
+
+void Downloads::setQueue(int queued, int inFlight) {
+    if(queued != m_queued || inFlight != m_inFlight) {
+        m_queued = queued;
+        m_inFlight = inFlight;
+        emit queueChanged();
+    }
+}
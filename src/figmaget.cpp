@@ -2,18 +2,26 @@
 #include "figmadata.h"
 #include "functorslot.h"
 #include "downloads.h"
+#include "imageprocessor.h"
+#include "diskcache.h"
 #include <QQmlEngine>
 #include <QNetworkReply>
 #include <QJsonDocument>
 #include <QJsonObject>
-#include <QImageReader>
-#include <QImageWriter>
-#include <QBuffer>
 #include <QFile>
 #include <QFileInfo>
+#include <QSaveFile>
 #include <QAbstractEventDispatcher>
+#include <QImage>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QtEndian>
+#include <QStandardPaths>
 #include <memory>
 #include <array>
+#ifdef HAS_ZLIB
+#include <zlib.h>
+#endif
 
 #include <QThread>
 
@@ -24,19 +32,134 @@ constexpr auto TIMEOUT_ERR = "%1 timeout \"%2\"";
 
 constexpr auto TimeoutTime = 60 * 1000;
 
-constexpr auto ImageRetry = 60 * 1000;
+constexpr auto ApiHost = "api.figma.com";
+
+constexpr auto MaxUrlLength = 2048;
+
+constexpr auto RenderingLatency = 10 * 1000; // batch size is tuned to keep a rendering call about this long
+constexpr auto MaxRenderingBatch = 500;
+constexpr auto MaxApiCalls = 4; // rendering and node batches run in parallel, the rate limiter paces them
 
 enum Format {
     None = 0, JPEG, PNG
 };
 
-const QLatin1String StreamId("FQ03");
+const QLatin1String LegacyStreamId("FQ03"); // everything in a single stream
+const QLatin1String StreamId("FQ04"); // blobs followed by their index
+
+// Zlib is the qCompress framing of the first FQ04 files, Deflate is a plain zlib stream
+enum class Codec : quint8 {Raw, Zlib, Deflate};
+
+using ByteSize = decltype(QByteArray().size()); // int with Qt5
+constexpr quint64 MaxBytes = std::numeric_limits<ByteSize>::max();
+
+#ifdef HAS_ZLIB
+constexpr quint64 ZlibChunk = 1024 * 1024;
+
+// deflates into the device a chunk at a time, returns the compressed size
+static std::optional<quint64> deflateTo(const QByteArray& bytes, QIODevice& device) {
+    z_stream zs{};
+    if(deflateInit(&zs, Z_DEFAULT_COMPRESSION) != Z_OK)
+        return std::nullopt;
+    const auto data = reinterpret_cast<const Bytef*>(bytes.constData());
+    const quint64 size = bytes.size();
+    std::vector<char> chunk(ZlibChunk);
+    quint64 consumed = 0;
+    quint64 written = 0;
+    int ret = Z_OK;
+    while(ret == Z_OK) {
+        if(zs.avail_in == 0 && consumed < size) {
+            const auto in = std::min(ZlibChunk, size - consumed);
+            zs.next_in = const_cast<Bytef*>(data + consumed);
+            zs.avail_in = static_cast<uInt>(in);
+            consumed += in;
+        }
+        zs.next_out = reinterpret_cast<Bytef*>(chunk.data());
+        zs.avail_out = static_cast<uInt>(chunk.size());
+        ret = deflate(&zs, consumed == size ? Z_FINISH : Z_NO_FLUSH);
+        const qint64 out = chunk.size() - zs.avail_out;
+        if(ret == Z_STREAM_ERROR || device.write(chunk.data(), out) != out)
+            ret = Z_STREAM_ERROR;
+        written += out;
+    }
+    deflateEnd(&zs);
+    return ret == Z_STREAM_END ? std::make_optional(written) : std::nullopt;
+}
+
+// inflates a chunk at a time straight from the source, e.g. the mapped file,
+// so there is no copy of the compressed blob
+static QByteArray inflateFrom(const uchar* data, quint64 size, quint64 sizeHint) {
+    z_stream zs{};
+    if(inflateInit(&zs) != Z_OK)
+        return {};
+    QByteArray bytes;
+    bytes.reserve(static_cast<ByteSize>(std::min(sizeHint, MaxBytes / 2)));
+    quint64 consumed = 0;
+    int ret = Z_OK;
+    while(ret == Z_OK) {
+        if(quint64(bytes.size()) + ZlibChunk > MaxBytes) {
+            ret = Z_MEM_ERROR; // does not fit into a QByteArray
+            break;
+        }
+        if(zs.avail_in == 0) {
+            if(consumed == size)
+                break; // truncated
+            const auto in = std::min(ZlibChunk, size - consumed);
+            zs.next_in = const_cast<Bytef*>(data + consumed);
+            zs.avail_in = static_cast<uInt>(in);
+            consumed += in;
+        }
+        const auto pos = bytes.size();
+        bytes.resize(pos + static_cast<ByteSize>(ZlibChunk));
+        zs.next_out = reinterpret_cast<Bytef*>(bytes.data() + pos);
+        zs.avail_out = static_cast<uInt>(ZlibChunk);
+        ret = inflate(&zs, Z_NO_FLUSH);
+        bytes.resize(pos + static_cast<ByteSize>(ZlibChunk - zs.avail_out));
+    }
+    inflateEnd(&zs);
+    return ret == Z_STREAM_END ? bytes : QByteArray();
+}
+#endif
+
+// bytes of a blob, or empty if it cannot be decoded
+static QByteArray decode(const uchar* data, quint64 size, quint8 codec) {
+    switch(static_cast<Codec>(codec)) {
+    case Codec::Raw:
+        return size <= MaxBytes ? QByteArray(reinterpret_cast<const char*>(data), static_cast<ByteSize>(size)) : QByteArray();
+    case Codec::Zlib:
+        if(size < 4)
+            return {};
+#ifdef HAS_ZLIB
+        // big endian length header of qCompress, then the stream
+        return inflateFrom(data + 4, size - 4, qFromBigEndian<quint32>(data));
+#else
+        return size <= quint64(std::numeric_limits<int>::max()) ? qUncompress(data, static_cast<int>(size)) : QByteArray();
+#endif
+    case Codec::Deflate:
+#ifdef HAS_ZLIB
+        return inflateFrom(data, size, size * 4);
+#else
+        return {}; // built without zlib
+#endif
+    }
+    return {};
+}
 
 // otherwise id can conflict
 QString asTimeoutId(const QString& id) {
     return id + "_timeout";
 }
 
+// takes at most maxCount ids from the queue as long as they fit into the URL
+QStringList takeBatch(QStringList& queue, int urlLength, int maxCount = std::numeric_limits<int>::max()) {
+    QStringList batch;
+    while(!queue.isEmpty() && (batch.isEmpty() || (batch.size() < maxCount && urlLength + queue.first().length() + 1 <= MaxUrlLength))) {
+        urlLength += queue.first().length() + 1;
+        batch.append(queue.takeFirst());
+    }
+    return batch;
+}
+
 class RAII_ {
 public:
     using Deldelegate = std::function<void()>;
@@ -56,6 +179,9 @@ FigmaGet::FigmaGet(QObject *parent) : FigmaProvider(parent),
     m_timeout{new Timeout(this)},
     m_error{new Execute(this)},
     m_downloads(new Downloads(this)),
+    m_imageProcessor(new ImageProcessor(this)),
+    m_imageCache(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/images"),
+    m_diskCache(new DiskCache(m_imageCache)),
     m_images(new FigmaData),
     m_renderings(new FigmaData),
     m_nodes(new FigmaData) {
@@ -70,6 +196,14 @@ FigmaGet::FigmaGet(QObject *parent) : FigmaProvider(parent),
 
      QObject::connect(&m_callTimer, &QTimer::timeout, this, &FigmaGet::doCall, Qt::QueuedConnection);
 
+     QObject::connect(this, &FigmaGet::imageCacheChanged, this, [this]() {
+         m_diskCache->setDirectory(m_imageCache);
+     });
+
+     QObject::connect(this, &FigmaGet::throttleChanged, this, [this]() {
+         m_rateLimiter.setMaxRate(1000. / std::max(1, m_throttle));
+     });
+
      QObject::connect(this, &FigmaGet::error, [this](const QString&) {
          cancel();
          m_connectionState = State::Error;
@@ -130,7 +264,10 @@ void FigmaGet::onRetrievedNode(const QString& nodeId) {
 
 bool FigmaGet::isReady() {
 
-    return m_callQueue.isEmpty() && m_timeout->pending() == 0;
+    return m_apiCalls.calls.isEmpty() && m_downloadCalls.calls.isEmpty()
+            && m_apiCalls.inFlight == 0 && m_downloadCalls.inFlight == 0
+            && m_imageProcessor->pending() == 0
+            && m_timeout->pending() == 0;
 }
 
 void FigmaGet::doFinished(QNetworkReply* rep)
@@ -150,37 +287,48 @@ void FigmaGet::retrieveImage(const Id& id,  FigmaData* target, const QSize& maxS
     Q_ASSERT(maxSize.width() > 0 && maxSize.height() > 0);
     queueCall([this, id, target, maxSize]() {
         return doRetrieveImage(id, target, maxSize);
-    });
+    }, Lane::Download);
 }
 
  void FigmaGet::requestRendering(const Id& imageId) {
 
-     if(!imageId.isEmpty()) {
-        m_rendringQueue.append(imageId.id);
-     }
-     queueCall([this, imageId](){
-         return FigmaGet::doRequestRendering(imageId);
-     });
+     m_rendringQueue.append(imageId.id);
+     auto batch = std::make_shared<QStringList>();
+     queueCall([this, batch](){
+         if(batch->isEmpty())
+             *batch = takeBatch(m_rendringQueue, renderingUrl({}).length(), m_renderingBatch);
+         return FigmaGet::doRequestRendering(*batch);
+     }, Lane::Api);
  }
 
 
 
+// nodes are requested in batches, a call takes what is queued when it is started
+// and keeps it if it is called again for a retry
 void FigmaGet::retrieveNode(const Id& id) {
-     queueCall([this, id]() {
-         doRetrieveNode(id);
-         return nullptr;
-     });
+     m_nodeQueue.append(id.id);
+     auto batch = std::make_shared<QStringList>();
+     queueCall([this, batch]() {
+         if(batch->isEmpty())
+             *batch = takeBatch(m_nodeQueue, nodeUrl({}).length());
+         return doRetrieveNodes(*batch);
+     }, Lane::Api);
  }
 
 bool FigmaGet::store(const QString& filename, unsigned flags, const QVariantMap& imports) {
 #ifdef Q_OS_WINDOWS
-    QFile file(filename.startsWith('/') ? filename.mid(1) : filename);
+    QSaveFile file(filename.startsWith('/') ? filename.mid(1) : filename);
 #else
-    QFile file(filename);
+    QSaveFile file(filename);
 #endif
+    if(!m_restoredFile.isEmpty() && QFileInfo(file.fileName()) == QFileInfo(m_restoredFile)) {
+        // lazy entries are read from the file that is replaced
+        for(auto data : {m_images.get(), m_renderings.get(), m_nodes.get()})
+            data->load();
+        m_restoredFile.clear();
+    }
     if(file.open(QIODevice::WriteOnly)) {
-        QDataStream stream(&file);
-        if(!write(stream, flags, imports)) {
+        if(!write(file, flags, imports) || !file.commit()) {
             emit error("Store failed " + filename);
             return false;
         }
@@ -196,13 +344,13 @@ FigmaGet::~FigmaGet() {
 
 bool FigmaGet::restore(const QString& filename) {
 #ifdef Q_OS_WINDOWS
-    QFile file(filename.startsWith('/') ? filename.mid(1) : filename);
+    auto file = std::make_shared<QFile>(filename.startsWith('/') ? filename.mid(1) : filename);
 #else
-    QFile file(filename);
+    auto file = std::make_shared<QFile>(filename);
 #endif
-    if(file.open(QIODevice::ReadOnly)) {
-        QDataStream stream(&file);
-        if(!read(stream)) {
+    if(file->open(QIODevice::ReadOnly)) {
+        QDataStream stream(file.get());
+        if(!read(stream, file)) {
             emit error("Restore failed on " + filename);
             return false;
         }
@@ -211,37 +359,157 @@ bool FigmaGet::restore(const QString& filename) {
             return false;
         }
     } else {
-        emit error("Restore error: " + file.errorString() + " "  + filename);
+        emit error("Restore error: " + file->errorString() + " "  + filename);
         return false;
       }
     return true;
 }
 
-bool FigmaGet::write(QDataStream& stream, unsigned flags, const QVariantMap& imports) const {
-
+/*
+ * Blobs are written first and the index last, the index offset is patched into
+ * the header. Restore reads only the index and project data, images and nodes
+ * are read from the memory mapped file when they are asked. JSON blobs are
+ * deflated as they are written, PNG and JPEG are stored as they are, and so is
+ * a blob that does not get smaller. Without zlib qCompress is used instead.
+ */
+bool FigmaGet::write(QFileDevice& file, unsigned flags, const QVariantMap& imports) const {
+
+    QDataStream stream(&file);
     stream << QString(StreamId);
+    const auto indexPos = file.pos();
+    stream << quint64(0);
+
+    const auto writeBlob = [&file](const QByteArray& bytes, bool compress) {
+        const quint64 offset = file.pos();
+        if(compress) {
+#ifdef HAS_ZLIB
+            const auto size = deflateTo(bytes, file);
+            if(size && *size < quint64(bytes.size()))
+                return std::make_tuple(offset, *size, Codec::Deflate);
+            file.seek(offset); // stored as it is, the raw blob replaces what was written
+            file.resize(offset);
+#else
+            const auto compressed = bytes.size() < std::numeric_limits<int>::max() ? qCompress(bytes) : QByteArray();
+            if(!compressed.isEmpty() && compressed.size() < bytes.size()) {
+                file.write(compressed);
+                return std::make_tuple(offset, quint64(compressed.size()), Codec::Zlib);
+            }
+#endif
+        }
+        file.write(bytes);
+        return std::make_tuple(offset, quint64(bytes.size()), Codec::Raw);
+    };
+
+    const auto [dataOffset, dataSize, dataCodec] = writeBlob(m_data, true);
+
+    using Entry = std::tuple<QString, QString, int, quint64, quint64, Codec>;
+    std::array<std::vector<Entry>, 3> tables;
+    const std::array<const FigmaData*, 3> sources{m_images.get(), m_renderings.get(), m_nodes.get()};
+    for(auto i = 0U; i < sources.size(); ++i) {
+        sources[i]->forEachCommitted([&](const QString& key, const QString& url, const QByteArray& bytes, int format) {
+            const auto [offset, size, codec] = writeBlob(bytes, format != PNG && format != JPEG);
+            tables[i].push_back({key, url, format, offset, size, codec});
+        });
+    }
+
+    const quint64 indexOffset = file.pos();
     stream << m_projectToken;
-    stream << m_data;
+    stream << dataOffset << dataSize << quint8(dataCodec);
     stream << m_checksum;
     stream << flags;
     stream << imports;
+    for(const auto& table : tables) {
+        stream << quint32(table.size());
+        for(const auto& [key, url, format, offset, size, codec] : table)
+            stream << key << url << format << offset << size << quint8(codec);
+    }
 
-
-    m_images->write(stream);
-    m_renderings->write(stream);
-    m_nodes->write(stream);
+    if(!file.seek(indexPos))
+        return false;
+    stream << indexOffset;
     return stream.status() == QDataStream::Ok;
 }
 
-bool FigmaGet::read(QDataStream& stream) {
+bool FigmaGet::read(QDataStream& stream, const std::shared_ptr<QFile>& file) {
 
     reset();
     QString streamid;
     stream >> streamid;
 
-    if(streamid  != StreamId)
+    if(streamid == LegacyStreamId)
+        return readLegacy(stream);
+
+    if(streamid != StreamId)
         return false;
 
+    quint64 indexOffset;
+    stream >> indexOffset;
+    const quint64 fileSize = file->size();
+    if(stream.status() != QDataStream::Ok || indexOffset > fileSize || !file->seek(indexOffset))
+        return false;
+
+    const auto map = file->map(0, fileSize);  // falls back to reads if mapping is not supported
+    const auto fileMutex = std::make_shared<QMutex>(); // loaders of the different FigmaData share the file
+    const auto blob = [file, map, fileMutex](quint64 offset, quint64 size, quint8 codec) {
+        if(map) // inflated straight from the mapped memory
+            return decode(map + offset, size, codec);
+        QByteArray bytes;
+        {
+            QMutexLocker lock(fileMutex.get());
+            const auto pos = file->pos();
+            file->seek(offset);
+            bytes = file->read(size);
+            file->seek(pos);
+        }
+        if(quint64(bytes.size()) != size)
+            return QByteArray();
+        return codec == quint8(Codec::Raw) ? bytes : decode(reinterpret_cast<const uchar*>(bytes.constData()), size, codec);
+    };
+    // offset and size are checked apart, their sum could wrap around
+    const auto isValid = [fileSize](quint64 offset, quint64 size, quint8 codec) {
+        return offset <= fileSize && size <= fileSize - offset && codec <= quint8(Codec::Deflate);
+    };
+
+    stream >> m_projectToken;
+    emit projectTokenChanged();
+
+    quint64 dataOffset, dataSize;
+    quint8 dataCodec;
+    stream >> dataOffset >> dataSize >> dataCodec;
+    if(!isValid(dataOffset, dataSize, dataCodec))
+        return false;
+    m_data = blob(dataOffset, dataSize, dataCodec);
+    stream >> m_checksum;
+    unsigned flags;
+    stream >> flags;
+
+    QVariantMap imports;
+    stream >> imports;
+
+    for(auto target : {m_images.get(), m_renderings.get(), m_nodes.get()}) {
+        quint32 count;
+        stream >> count;
+        for(auto i = 0U; i < count && stream.status() == QDataStream::Ok; ++i) {
+            QString key, url;
+            int format;
+            quint64 offset, size;
+            quint8 codec;
+            stream >> key >> url >> format >> offset >> size >> codec;
+            if(!isValid(offset, size, codec))
+                return false;
+            target->insertLazy(key, url, format, [blob, offset, size, codec]() {
+                return blob(offset, size, codec);
+            });
+        }
+    }
+
+    m_restoredFile = file->fileName(); // lazy entries are read from it
+    emit restored(flags, imports);
+    return stream.status() == QDataStream::Ok;
+}
+
+bool FigmaGet::readLegacy(QDataStream& stream) {
+
     stream >> m_projectToken;
     emit projectTokenChanged();
 
@@ -266,6 +534,12 @@ void FigmaGet::reset() {
     m_images->clear();
     m_renderings->clear();
     m_nodes->clear();
+    m_restoredFile.clear();
+    m_apiCalls.calls.clear();
+    m_downloadCalls.calls.clear();
+    m_rendringQueue.clear();
+    m_nodeQueue.clear();
+    updateQueue();
 }
 
 void FigmaGet::cancel() {
@@ -278,26 +552,103 @@ void FigmaGet::cancel() {
     m_downloads->cancel();
 }
 
-void FigmaGet::doCall() {
-    if(m_callQueue.isEmpty()) {
+FigmaGet::Lane FigmaGet::laneOf(const QUrl& url) {
+    return url.host() == ApiHost ? Lane::Api : Lane::Download;
+}
+
+bool FigmaGet::startCall(CallLane& lane) {
+    const auto call = lane.calls.dequeue();
+    auto reply = call();
+    if(!reply)
+        return false;
+    m_downloads->monitor(reply, call);
+    ++lane.inFlight;
+    const auto isDownload = &lane == &m_downloadCalls;
+    QObject::connect(reply, &QNetworkReply::finished, this, [this, &lane, isDownload, reply]() {
+        --lane.inFlight;
+        if(isDownload) {
+            if(reply->error() == QNetworkReply::NoError)
+                m_downloadBackoff.success();
+            doDownloads();
+        } else {
+            if(reply->error() == QNetworkReply::NoError)
+                m_rateLimiter.success();
+            rateLimit(reply);
+            doCall(); // a slot is free
+        }
+    });
+    return true;
+}
+
+// downloads are started as soon as there is a free slot, unless the CDN asked to back off
+void FigmaGet::doDownloads() {
+    if(m_downloadBackoff.remaining() == 0) {
+        while(!m_downloadCalls.calls.isEmpty() && m_downloadCalls.inFlight < std::max(1, m_concurrency))
+            startCall(m_downloadCalls);
+    }
+    updateQueue();
+}
 
+// API calls are rate limited, a call is started for each token the limiter has
+// while there are less than MaxApiCalls in flight
+void FigmaGet::doCall() {
+    if(m_apiCalls.calls.isEmpty()) {
         m_callTimer.stop();
+    } else {
+        while(!m_apiCalls.calls.isEmpty() && m_apiCalls.inFlight < MaxApiCalls && m_rateLimiter.tryAcquire()) {
+            // a batched call finds nothing to do if an earlier one took its ids
+            while(!m_apiCalls.calls.isEmpty() && !startCall(m_apiCalls));
+        }
     }
-    else {
+    updateQueue();
+}
 
-        const auto call = m_callQueue.dequeue();
-        auto reply = call();
-        m_downloads->monitor(reply, call);
+// Retry-After is either seconds or a HTTP date, -1 if not given
+static qint64 retryAfter(const QNetworkReply* reply) {
+    const auto value = reply->rawHeader("Retry-After").trimmed();
+    if(value.isEmpty())
+        return -1;
+    bool ok;
+    const auto seconds = value.toLongLong(&ok);
+    if(ok)
+        return std::max<qint64>(0, seconds * 1000);
+    const auto date = QDateTime::fromString(QString::fromLatin1(value), Qt::RFC2822Date);
+    return date.isValid() ? std::max<qint64>(0, QDateTime::currentDateTimeUtc().msecsTo(date)) : -1;
+}
+
+void FigmaGet::rateLimit(const QNetworkReply* reply) {
+    for(const auto& prefix : {QByteArray("X-RateLimit-"), QByteArray("RateLimit-")}) {
+        bool remainingOk, resetOk;
+        const auto remaining = reply->rawHeader(prefix + "Remaining").toInt(&remainingOk);
+        auto reset = reply->rawHeader(prefix + "Reset").toLongLong(&resetOk);
+        if(!remainingOk || !resetOk)
+            continue;
+        if(reset > 1000000000) // epoch seconds instead of seconds to go
+            reset -= QDateTime::currentSecsSinceEpoch();
+        m_rateLimiter.limit(remaining, reset * 1000);
+        return;
     }
 }
 
-void FigmaGet::queueCall(const NetworkFunction& call) {
+void FigmaGet::updateQueue() {
+    m_downloads->setQueue(m_apiCalls.calls.size() + m_downloadCalls.calls.size(),
+                          m_apiCalls.inFlight + m_downloadCalls.inFlight);
+}
+
+void FigmaGet::queueCall(const NetworkFunction& call, Lane lane) {
+
+    if(lane == Lane::Download) {
+        m_downloadCalls.calls.enqueue(call);
+        doDownloads();
+        return;
+    }
 
-    m_callQueue.enqueue(call);
+    m_apiCalls.calls.enqueue(call);
 #ifndef NO_THROTTLED_CALL
     if(!m_callTimer.isActive()) {
         m_callTimer.start(m_throttle);
     }
+    updateQueue();
 #else
     doCall();
 #endif
@@ -359,6 +710,11 @@ void FigmaGet::getImage(const QString &imageRef, const QSize& maxSize) {
     Q_ASSERT(maxSize.width() > 0 && maxSize.height() > 0);
     Q_ASSERT(!imageRef.isEmpty());
 
+    if(fromDiskCache(imageRef, maxSize)) {
+        emit imageReady(imageRef, m_images->data(imageRef), m_images->format(imageRef));
+        return;
+    }
+
     if(!m_images->contains(imageRef)) {
         auto connection = std::make_shared<QMetaObject::Connection>();
         const auto tid = Id{asTimeoutId(imageRef), IdType::IMAGE};
@@ -391,6 +747,20 @@ void FigmaGet::getImage(const QString &imageRef, const QSize& maxSize) {
 
 
 
+// images found from the disk cache need neither the URL population nor a download
+bool FigmaGet::fromDiskCache(const QString& imageRef, const QSize& maxSize) {
+    if(m_images->contains(imageRef) && (!m_images->isEmpty(imageRef) || m_images->isError(imageRef) || m_images->isPending(imageRef)))
+        return !m_images->isEmpty(imageRef);
+    const auto bytes = m_diskCache->read(imageRef, maxSize);
+    if(!bytes)
+        return false;
+    if(!m_images->contains(imageRef))
+        m_images->insert(imageRef);
+    m_images->setPending(imageRef);
+    m_images->setBytes(imageRef, *bytes, bytes->startsWith("\x89PNG") ? PNG : JPEG);
+    return true;
+}
+
 QNetworkReply* FigmaGet::doRetrieveImage(const Id& id, FigmaData *target, const QSize &maxSize) {
 
     QNetworkRequest request;
@@ -409,46 +779,23 @@ QNetworkReply* FigmaGet::doRetrieveImage(const Id& id, FigmaData *target, const
     std::shared_ptr<QByteArray> bytes(new QByteArray);
 
     const auto finished = [this, bytes, target, maxSize, id]() {
-        QBuffer imageBuffer(bytes.get(), this);
-        QImageReader imageReader(&imageBuffer);
-        const auto format = imageReader.format();
-        if(!(format == "png" || format == "jpeg" || format == "jpg")) {
-            setError(id, "%1 %2" + QString("format not supported \"%1\"").arg(QString(format)));
-            return;
-        }
-
-            if(maxSize.width() < std::numeric_limits<int>::max() || maxSize.height() < std::numeric_limits<int>::max()) {
 #ifdef DUMP_IMAGE
 #pragma message("DUMP_IMAGE is defined, Do dump for every rendering...")
-            const auto dumpImage = imageReader.read();
-            dumpImage.save("figma_+ " + id + "." + imageReader.format());
+        QImage::fromData(*bytes).save("figma_" + id.id + ".png");
 #endif
-            if(imageReader.size().width() > maxSize.width() || imageReader.size().height() > maxSize.height()) {
-
-                const auto image = imageReader.read();
-                const auto scaled = image.scaled(maxSize, Qt::KeepAspectRatio);
-                bytes->clear();
-
-                QBuffer buffer(bytes.get(), this);
-                if(scaled.isNull() || !buffer.open(QIODevice::WriteOnly)) {
-                    setError(id, "%1 %2" + QString(" cannot be resized to %2x%3").arg(maxSize.width(), maxSize.height()));
-                    return;
-                }
-
-                QImageWriter writer(&buffer, format);
-                if(!writer.write(scaled)) {
-                    setError(id, "%1 %2" + QString(" cannot be resized %2")
-                                   .arg(writer.errorString()));
-                    return;
-                }
-                buffer.close();
+        m_imageProcessor->process(*bytes, maxSize, [this, target, id, maxSize](const ImageProcessor::Image& image) {
+            if(!image.error.isEmpty()) {
+                setError(id, "%1 %2 " + image.error);
+                return;
             }
-        }
-        if(target->isEmpty(id.id) && m_connectionState == State::Loading) {  //there CAN be multiple requests within multithreaded, but we use only first
-            Q_ASSERT(format == "png" || format == "jpeg");
-            target->setBytes(id.id, *bytes, format == "png" ? PNG : JPEG);
-        }
-        emit imageRetrieved(id.id);
+            //there CAN be multiple requests within multithreaded, but we use only first
+            if(m_connectionState == State::Loading && target->contains(id.id) && target->isEmpty(id.id)) {
+                target->setBytes(id.id, image.bytes, image.format == "png" ? PNG : JPEG);
+                if(id.type == IdType::IMAGE) // renderings are not content addressed
+                    m_diskCache->write(id.id, maxSize, image.bytes);
+            }
+            emit imageRetrieved(id.id);
+        });
     };
 
     setTimeout(reply, id);
@@ -522,7 +869,9 @@ void FigmaGet::getRendering(const QString& imageId) {
         const auto tid = Id{asTimeoutId(imageId), IdType::RENDERING};
         m_renderings->insert(imageId);
         setTimeout(connection, tid);
-        *connection = QObject::connect(this, &FigmaGet::imageRendered, [this, connection, imageId, tid](const QString&) {
+        *connection = QObject::connect(this, &FigmaGet::imageRendered, [this, connection, imageId, tid](const QString& key) {
+            if(key != imageId)
+                return; // renderings of a batch are completed one by one
             m_timeout->cancel(tid.id);
             QObject::disconnect(*connection);
             if(m_renderings->contains(imageId)) {
@@ -550,54 +899,65 @@ void FigmaGet::getRendering(const QString& imageId) {
 }
 
 
-QNetworkReply* FigmaGet::doRequestRendering(const Id& id) {
+QString FigmaGet::renderingUrl(const QStringList& ids) const {
+    const QStringList params{
+        "ids=" + ids.join(','),
+        "use_absolute_bounds=true"
+    };
+    return "https://api.figma.com/v1/images/" + m_projectToken + "?" + params.join('&');
+}
 
-    if(m_rendringQueue.isEmpty())
+QNetworkReply* FigmaGet::doRequestRendering(const QStringList& ids) {
+
+    if(ids.isEmpty())
         return nullptr;
 
     QNetworkRequest request;
     request.setAttribute(QNetworkRequest::Http2AllowedAttribute, false);
 
-    const QStringList params{
-        "ids=" + m_rendringQueue.join(','),
-        "use_absolute_bounds=true"
-    };
-    m_rendringQueue.clear();
-
-    request.setUrl(QUrl("https://api.figma.com/v1/images/" + m_projectToken + "?" + params.join('&')));
+    request.setUrl(renderingUrl(ids));
     request.setRawHeader("X-Figma-Token", m_userToken.toLatin1());
 
     auto reply = m_accessManager->get(request);
     std::shared_ptr<QByteArray> bytes(new QByteArray);
 
+    QElapsedTimer latency;
+    latency.start();
 
-    QObject::connect(reply, &QNetworkReply::destroyed, this, [this](QObject*) {
-           if(!m_rendringQueue.isEmpty()) {
-               requestRendering({QString(), IdType::RENDERING}); // type has no meaning
-           }
-    });
+    const auto batchError = [this, ids](const QString& reason) {
+        for(const auto& id : ids)
+            m_renderings->setError(id);
+        emit error(QString(reason).arg("Rendering", ids.join(',')));
+    };
+
+    const auto finished =  [this, bytes, ids, latency, batchError]() {
+        // slow server gets smaller batches, fast one bigger
+        const auto elapsed = latency.elapsed();
+        if(elapsed > RenderingLatency)
+            m_renderingBatch = std::max(1, m_renderingBatch / 2);
+        else if(elapsed < RenderingLatency / 2 && ids.size() >= m_renderingBatch)
+            m_renderingBatch = std::min(MaxRenderingBatch, m_renderingBatch * 2);
 
-    const auto finished =  [this, bytes, id]() {
         if(bytes->isEmpty()) {
-           setError(id, "%1 \"%2\" Error - no data");
+           batchError("%1 \"%2\" Error - no data");
            return;
         }
         QJsonParseError err;
         const auto doc = QJsonDocument::fromJson(*bytes, &err);
         if(err.error != QJsonParseError::NoError) {
-           setError(id, "%1 \"%2\"" + QString("Error on rendering - JSON: %1 at %2")
-                    .arg(err.errorString(), err.offset));
+           batchError("%1 \"%2\"" + QString("Error on rendering - JSON: %1 at %2")
+                    .arg(err.errorString()).arg(err.offset));
             qDebug() << "JSON - size:" << bytes->size() << "dump: " << *bytes;
             return;
         }
         const auto obj = doc.object();
         if(obj["error"].toBool()) {
-            setError(id, "%1 \"%2\"" + QString("Status %1").arg(obj["status"].toString()));
+            batchError("%1 \"%2\"" + QString("Status %1").arg(obj["status"].toString()));
         } else {
             const auto renderings = obj["images"].toObject();
             for(const auto& key : renderings.keys()) {
                 if(renderings[key].toString().isEmpty()) {
-                    setError(id, "%1 \"%2\"" + QString("Invalid URL key:\"%1\"").arg(key));
+                    setError({key, IdType::RENDERING}, "%1 \"%2\"" + QString("Invalid URL key:\"%1\"").arg(key));
                     break;
                 }
                 m_renderings->setUrl(key, renderings[key].toString());
@@ -605,7 +965,8 @@ QNetworkReply* FigmaGet::doRequestRendering(const Id& id) {
             }
         }
     };
-    setTimeout(reply, id);
+    for(const auto& id : ids)
+        setTimeout(reply, {id, IdType::RENDERING});
     monitorReply(reply, bytes, finished);
     return reply;
 }
@@ -664,46 +1025,101 @@ void FigmaGet::documentCreated() {
 void FigmaGet::getNode(const QString &id) {
 
     if(!m_nodes->contains(id)) {
-        const QStringList params{
-            "ids=" + id,
-            "geometry=paths"
-        };
         m_nodes->insert(id);
-        m_nodes->setUrl(id, "https://api.figma.com/v1/files/" + m_projectToken + "/nodes?" + params.join('&'));
     }
 
     if(!m_nodes->isEmpty(id)) {
         emit nodeReady(m_nodes->data(id));
+        return;
     }
 
-    if(m_nodes->setPending(id))
+    if(!m_nodes->setPending(id))
         return; // already on its way
 
     retrieveNode({id, IdType::NODE});
 }
 
-void FigmaGet::doRetrieveNode(const Id& id) {
+void FigmaGet::prefetch(const QStringList& prefetchRefs, const QStringList& figmaIds, const QStringList& nodeIds, const QSize& maxSize) {
+    // committed entries are not touched, restored ones are loaded only when parsed
+    for(const auto& id : nodeIds) {
+        if(!m_nodes->isCommitted(id))
+            getNode(id);
+    }
+
+    for(const auto& id : figmaIds) {
+        if(!m_renderings->isCommitted(id))
+            getRendering(id);
+    }
+
+    QStringList imageRefs;
+    for(const auto& imageRef : prefetchRefs) {
+        if(!fromDiskCache(imageRef, maxSize))
+            imageRefs.append(imageRef);
+    }
 
+    if(imageRefs.isEmpty())
+        return;
+
+    const auto fetchImages = [this, imageRefs, maxSize]() {
+        for(const auto& imageRef : imageRefs) {
+            if(m_images->contains(imageRef)) // unknown ones are reported when parsed
+                getImage(imageRef, maxSize);
+        }
+    };
+
+    if(m_images->size() > 0 && !m_populationOngoing) {
+        fetchImages();
+        return;
+    }
+
+    auto connection = std::make_shared<QMetaObject::Connection>();
+    *connection = QObject::connect(this, &FigmaGet::imagesPopulated, this, [connection, fetchImages]() {
+        QObject::disconnect(*connection);
+        fetchImages();
+    });
+    if(!m_populationOngoing)
+        populateImages();
+}
+
+QString FigmaGet::nodeUrl(const QStringList& ids) const {
+    const QStringList params{
+        "ids=" + ids.join(','),
+        "geometry=paths"
+    };
+    return "https://api.figma.com/v1/files/" + m_projectToken + "/nodes?" + params.join('&');
+}
+
+QNetworkReply* FigmaGet::doRetrieveNodes(const QStringList& ids) {
+
+    if(ids.isEmpty())
+        return nullptr;
 
     QNetworkRequest request;
     request.setAttribute(QNetworkRequest::Http2AllowedAttribute, false);
 
-    const auto uri = m_nodes->url(id.id);
-    request.setUrl(uri);
+    request.setUrl(nodeUrl(ids));
     request.setRawHeader("X-Figma-Token", m_userToken.toLatin1());
 
     auto reply = m_accessManager->get(request);
 
     std::shared_ptr<QByteArray> bytes(new QByteArray);
 
-    const auto finished = [this, bytes, id] () {
-        if(m_connectionState == State::Loading)
-            m_nodes->setBytes(id.id, *bytes);
-        emit nodeRetrieved(id.id);
+    // response is split so that each node is stored as if it was requested alone
+    const auto finished = [this, bytes, ids] () {
+        const auto nodes = QJsonDocument::fromJson(*bytes).object()["nodes"].toObject();
+        for(const auto& id : ids) {
+            if(m_connectionState == State::Loading && nodes.contains(id)) {
+                const QJsonObject node{{"nodes", QJsonObject{{id, nodes[id]}}}};
+                m_nodes->setBytes(id, QJsonDocument(node).toJson(QJsonDocument::Compact));
+            }
+            emit nodeRetrieved(id);
+        }
     };
 
-    setTimeout(reply, id);
+    for(const auto& id : ids)
+        setTimeout(reply, {id, IdType::NODE});
     monitorReply(reply, bytes, finished);
+    return reply;
 }
 
 
@@ -736,9 +1152,23 @@ void FigmaGet::onReplyError(QNetworkReply::NetworkError err)
         if(code == 429) {
             emit m_downloads->tooManyRequests();
             const auto faildedCall = m_downloads->monitored(reply);
-            QTimer::singleShot(ImageRetry, this, [this, faildedCall]() { //figma doc says about one minute
-                queueCall(faildedCall);
-            });
+            if(laneOf(reply->url()) == Lane::Api) {
+                m_rateLimiter.tooManyRequests(retryAfter(reply));
+                if(!faildedCall)
+                    return;
+                m_apiCalls.calls.prepend(faildedCall); // limiter holds it until the pause is over
+                if(!m_callTimer.isActive())
+                    m_callTimer.start(m_throttle);
+                updateQueue();
+            } else {
+                m_downloadBackoff.tooManyRequests(retryAfter(reply));
+                if(!faildedCall)
+                    return;
+                m_downloadCalls.calls.prepend(faildedCall);
+                // an earlier pause may last longer than this one
+                QTimer::singleShot(m_downloadBackoff.remaining(), this, &FigmaGet::doDownloads);
+                updateQueue();
+            }
         }  else {
             emit error("HTTP error: " + reply->errorString());
         }
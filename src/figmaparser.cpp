@@ -11,9 +11,18 @@
 #include <QStack>
 #include <QFont>
 #include <QColor>
+#include <QCryptographicHash>
 #include <stack>
 #include <optional>
 #include <cmath>
+#include <numeric>
+#include <algorithm>
+#include <list>
+#ifndef NO_CONCURRENT
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
+#endif
 
 #include <QTimer>
 
@@ -22,7 +31,7 @@
 #endif
 
 
-static QString last_parse_error;
+static thread_local QString last_parse_error; // parses run concurrently
 
 using EByteArray = FigmaParser::EByteArray;
 
@@ -30,7 +39,66 @@ using EByteArray = FigmaParser::EByteArray;
 
 static inline bool eq(double a, double b) {return std::fabs(a - b) < std::numeric_limits<double>::epsilon();}
 
-#define APPENDERR(val, fn) {const auto ob_ = fn; if(!ob_) return std::nullopt; val += ob_.value();}
+// document strings in QML string literals and comments, control characters are
+// escaped so they cannot be taken as image references of the parsed output
+static QString toQmlString(const QString& text) {
+    QString out;
+    out.reserve(text.size());
+    for(const auto c : text) {
+        switch(c.unicode()) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if(c.unicode() < 0x20)
+                out += QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0'));
+            else
+                out += c;
+        }
+    }
+    return out;
+}
+
+#define APPENDERR(val, fn) {auto ob_ = fn; if(!ob_) return std::nullopt; val += std::move(ob_.value());}
+
+// copied subtrees of at least this many nodes, repeated at least this many times become components
+constexpr int RepeatedNodes = 8;
+constexpr int RepeatedCount = 3;
+
+// child subtrees of at least this many nodes are parsed as separate tasks
+constexpr int ForkNodes = 2000;
+
+#ifndef NO_CONCURRENT
+// a task that is joined before a worker picked it is taken back and run by the joiner,
+// therefore a parse waiting its subtrees never starves the pool
+class SubtreeTask : public QRunnable {
+public:
+    explicit SubtreeTask(std::function<void ()>&& task) : m_task(std::move(task)) {
+        setAutoDelete(false);
+        QThreadPool::globalInstance()->start(this);
+    }
+    ~SubtreeTask() {
+        join();
+    }
+    void run() override {
+        m_task();
+        m_done.release();
+    }
+    void join() {
+        if(m_joined)
+            return;
+        if(QThreadPool::globalInstance()->tryTake(this))
+            run();
+        m_done.acquire();
+        m_joined = true;
+    }
+private:
+    std::function<void ()> m_task;
+    QSemaphore m_done;
+    bool m_joined = false;
+};
+#endif
 
 QByteArray FigmaParser::fontWeight(double v) {
    const auto scaled = ((v - 100) / 900) * 90; // figma scale is 100-900, where Qt is enums
@@ -54,7 +122,7 @@ QByteArray FigmaParser::fontWeight(double v) {
 }
 
 std::optional<FigmaParser::ItemType> FigmaParser::type(const QJsonObject& obj) {
-   const QHash<QString, ItemType> types { //this to make sure we have a case for all types
+   static const QHash<QString, ItemType> types { //this to make sure we have a case for all types
        {"RECTANGLE", ItemType::Vector},
        {"TEXT", ItemType::Text},
        {"COMPONENT", ItemType::Component},
@@ -73,34 +141,39 @@ std::optional<FigmaParser::ItemType> FigmaParser::type(const QJsonObject& obj) {
 
    };
    const auto type = obj["type"].toString();
-   if(!types.contains(type)) {
+   const auto it = types.find(type);
+   if(it == types.end()) {
        ERR(QString("Non supported object type:\"%1\"").arg(type))
    }
-   return types[type];
+   return *it;
 }
 
 
-std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject& project, FigmaParserData& data) {
+std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject& project, const Index& index, FigmaParserData& data) {
         Components map;
-        auto componentObjects = getObjectsByType(project["document"].toObject(), "COMPONENT");
+        QHash<QString, QJsonObject> componentObjects;
         const auto components = project["components"].toObject();
+        QStringList missing;
         for (const auto& key : components.keys()) {
-            if(!componentObjects.contains(key)) {
+            if(index.contains(key)) {
+                componentObjects.insert(key, index.object(key));
+            } else {
                 const auto response = data.nodeData(key);
                 if(response.isEmpty()) {
-                    ERR(toStr("Component not found", key, "for"))
+                    missing.append(key); // all missing nodes are requested at once
+                    continue;
                 }
                 QJsonParseError err;
                 const auto obj = QJsonDocument::fromJson(response, &err).object();
                 if(err.error == QJsonParseError::NoError) {
-                    const auto receivedObjects = getObjectsByType(obj["nodes"]
+                    const Index received(obj["nodes"]
                             .toObject()[key]
                             .toObject()["document"]
-                            .toObject(), "COMPONENT");
-                    if(!receivedObjects.contains(key)) {
+                            .toObject());
+                    if(received.object(key)["type"] != "COMPONENT") {
                          ERR(toStr("Unrecognized component", key));
                     }
-                    componentObjects.insert(key, receivedObjects[key]);
+                    componentObjects.insert(key, received.object(key));
                 } else {
                     ERR(toStr("Invalid component", key));
                 }
@@ -125,6 +198,9 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
                                 std::move(componentObjects[key]))));
 
         }
+        if(!missing.isEmpty()) {
+            ERR(toStr("Component not found", missing.join(',')))
+        }
         return map;
     }
 
@@ -148,13 +224,136 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
         return array;
     }
 
-     std::optional<FigmaParser::Element> FigmaParser::component(const QJsonObject& obj, unsigned flags, FigmaParserData& data, const Components& components) {
-        FigmaParser p(flags | Flags::ParseComponent, data, &components);
+    // keys a copy differs in wherever it is placed
+    static const char* const PlacementKeys[] = {"id", "absoluteBoundingBox", "absoluteRenderBounds", "relativeTransform"};
+
+    // digests of a subtree ignore the placement keys of every node, but the relative positions of
+    // the children are hashed into their parent. Other keys, such as the size, must match.
+    static std::tuple<QByteArray, QByteArray, int> subtreeDigest(const QJsonObject& obj, QHash<QString, std::tuple<QByteArray, int>>& digests) {
+        auto props = obj;
+        props.remove("children");
+        for(const auto& key : PlacementKeys)
+            props.remove(key);
+        QCryptographicHash root(QCryptographicHash::Sha1);
+        root.addData(QJsonDocument(props).toJson(QJsonDocument::Compact));
+        int nodes = 1;
+        const auto children = obj["children"].toArray();
+        for(const auto& c : children) {
+            const auto [childDigest, childRoot, childNodes] = subtreeDigest(c.toObject(), digests);
+            root.addData(childDigest);
+            nodes += childNodes;
+        }
+        const auto rootDigest = root.result();
+        QCryptographicHash digest(QCryptographicHash::Sha1);
+        digest.addData(rootDigest);
+        digest.addData(QJsonDocument(obj["relativeTransform"].toArray()).toJson(QJsonDocument::Compact));
+        const auto type = obj["type"].toString();
+        if(type == "FRAME" || type == "GROUP")
+            digests.insert(obj["id"].toString(), {rootDigest, nodes});
+        return {digest.result(), rootDigest, nodes};
+    }
+
+    void FigmaParser::extractRepeated(const QJsonObject& document, Components& components) {
+        QHash<QString, std::tuple<QByteArray, int>> digests;
+        subtreeDigest(document, digests);
+        // nodes in document order with the index past their subtree, instances and their contents are already components
+        std::vector<std::pair<QJsonObject, std::size_t>> nodes;
+        std::function<void (const QJsonObject&)> collect = [&nodes, &collect](const QJsonObject& obj) {
+            const auto index = nodes.size();
+            nodes.push_back({obj, 0});
+            if(obj["type"] != "INSTANCE") {
+                const auto children = obj["children"].toArray();
+                for(const auto& c : children)
+                    collect(c.toObject());
+            }
+            nodes[index].second = nodes.size();
+        };
+        collect(document);
+        QSet<QByteArray> excluded;
+        QHash<QByteArray, QStringList> sites;
+        std::vector<QByteArray> order;
+        for(;;) {
+            QHash<QByteArray, int> counts;
+            for(const auto& [obj, end] : nodes) {
+                const auto digest = digests.constFind(obj["id"].toString());
+                if(obj["type"] != "INSTANCE" && digest != digests.constEnd() && std::get<1>(*digest) >= RepeatedNodes)
+                    ++counts[std::get<0>(*digest)];
+            }
+            // only the topmost copies are replaced
+            sites.clear();
+            order.clear();
+            for(std::size_t i = 0; i < nodes.size();) {
+                const auto& [obj, end] = nodes[i];
+                const auto id = obj["id"].toString();
+                const auto digest = digests.constFind(id);
+                const auto d = digest != digests.constEnd() ? std::get<0>(*digest) : QByteArray();
+                if(obj["type"] == "INSTANCE" || d.isEmpty() || excluded.contains(d) || counts.value(d) < RepeatedCount) {
+                    ++i;
+                    continue;
+                }
+                auto& ids = sites[d];
+                if(ids.isEmpty())
+                    order.push_back(d);
+                ids.append(id);
+                i = end;
+            }
+            // copies nested in replaced subtrees are not sites, what is left may not repeat enough
+            bool stable = true;
+            for(auto it = sites.constBegin(); it != sites.constEnd(); ++it) {
+                if(it.value().size() < RepeatedCount) {
+                    excluded.insert(it.key());
+                    stable = false;
+                }
+            }
+            if(stable)
+                break;
+        }
+        // names are given in document order, hence they are the same on every run
+        for(const auto& digest : order) {
+            const auto& ids = sites[digest];
+            const auto first = std::find_if(nodes.begin(), nodes.end(), [&ids](const auto& node) {
+                return node.first["id"].toString() == ids.first();
+            });
+            Q_ASSERT(first != nodes.end());
+            auto object = first->first;
+            const auto baseName = object["name"].toString() + "_repeated";
+            auto name = validFileName(baseName, false);
+            int count = 1;
+            while(std::find_if(components.begin(), components.end(), [&name](const auto& c) {
+                return c->name() == name;
+            }) != components.end()) {
+                name = validFileName(QString("%1_%2").arg(baseName).arg(count), false);
+                ++count;
+            }
+            const auto id = object["id"].toString();
+            const auto component = std::make_shared<Component>(name, id, QString(), QString("Repeated subtree"), std::move(object));
+            for(const auto& site : ids)
+                components.insert(site, component); // sites are aliases of the component
+        }
+    }
+
+    FigmaParser::Resources FigmaParser::resources(const QJsonObject& project, const Index& index, const std::vector<QJsonObject>& elements, unsigned flags, FigmaParserData& data) {
+        Resources resources;
+        FigmaParser p(flags, data, nullptr, &index);
+        const auto components = project["components"].toObject();
+        for(const auto& key : components.keys()) {
+            if(!index.contains(key))
+                resources.nodes.insert(key);
+            else
+                p.collectResources(index.object(key), resources); // components are parsed whatever the filter is
+        }
+        for(const auto& element : elements)
+            p.collectResources(element, resources);
+        return resources;
+    }
+
+     std::optional<FigmaParser::Element> FigmaParser::component(const QJsonObject& obj, unsigned flags, FigmaParserData& data, const Components& components, const Index& index) {
+        FigmaParser p(flags | Flags::ParseComponent, data, &components, &index);
         return p.getElement(obj);
     }
 
-     std::optional<FigmaParser::Element> FigmaParser::element(const QJsonObject& obj, unsigned flags, FigmaParserData& data, const Components& components) {
-        FigmaParser p(flags, data, &components);
+     std::optional<FigmaParser::Element> FigmaParser::element(const QJsonObject& obj, unsigned flags, FigmaParserData& data, const Components& components, const Index& index) {
+        FigmaParser p(flags, data, &components, &index);
         return p.getElement(obj);
     }
 
@@ -188,40 +387,84 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
         return name;
     }
 
-    FigmaParser::FigmaParser(unsigned flags, FigmaParserData& data, const Components* components) : m_flags(flags), m_data(data), m_components(components) {}
-
-
-    QHash<QString, QJsonObject> FigmaParser::getObjectsByType(const QJsonObject& obj, const QString& type) {
-        QHash<QString, QJsonObject>objects;
-        if(obj["type"] == type) {
-            objects.insert(obj["id"].toString(), obj);
-        } else if(obj.contains("children")) {
+    FigmaParser::FigmaParser(unsigned flags, FigmaParserData& data, const Components* components, const Index* index) :
+        m_flags(flags), m_data(data), m_components(components), m_index(index) {}
+
+
+    FigmaParser::Index::Index(const QJsonObject& document) {
+        std::stack<std::pair<QJsonObject, int>> stack; // iterative, documents can be deep, the second is the parent position
+        std::vector<int> parents;
+        stack.push({document, -1});
+        while(!stack.empty()) {
+            const auto [obj, parent] = stack.top();
+            stack.pop();
+            const auto pos = static_cast<int>(m_nodes.size());
+            m_nodes.push_back(obj);
+            parents.push_back(parent);
+            m_positions.insert(obj["id"].toString(), pos);
+            m_types[obj["type"].toString()].push_back(pos);
             const auto children = obj["children"].toArray();
-            for(const auto& child : children) {
-                const auto childrenobjects = getObjectsByType(child.toObject(), type);
-                const auto keys = childrenobjects.keys();
-                for(const auto& k : keys) {
-                    objects.insert(k, childrenobjects[k]);
-                }
+            for(auto it = children.end(); it != children.begin();) // reversed, so that they are popped in order
+                stack.push({(*--it).toObject(), pos});
+        }
+        // a subtree ends where its last descendant is, children come after their parent,
+        // hence their ends and digests are ready when the parent is visited
+        m_ends.resize(m_nodes.size());
+        m_digests.resize(m_nodes.size());
+        for(auto pos = static_cast<int>(m_nodes.size()) - 1; pos >= 0; --pos) {
+            m_ends[pos] = std::max(m_ends[pos], pos + 1);
+            if(parents[pos] >= 0)
+                m_ends[parents[pos]] = std::max(m_ends[parents[pos]], m_ends[pos]);
+            const auto& obj = m_nodes[pos];
+            QJsonObject props;
+            for(auto it = obj.begin(); it != obj.end(); ++it) {
+                if(it.key() != "children")
+                    props.insert(it.key(), it.value());
             }
+            QCryptographicHash hash(QCryptographicHash::Sha1);
+            hash.addData(QJsonDocument(props).toJson(QJsonDocument::Compact));
+            for(auto child = pos + 1; child < m_ends[pos]; child = m_ends[child])
+                hash.addData(m_digests[child]);
+            m_digests[pos] = hash.result();
+        }
+    }
+
+    // nodes of the type in the subtree, or in the document if subtree is empty
+    std::vector<QJsonObject> FigmaParser::Index::objects(const QString& type, const QString& subtree) const {
+        std::vector<QJsonObject> objects;
+        const auto positions = m_types.constFind(type);
+        if(positions == m_types.constEnd())
+            return objects;
+        auto begin = positions->begin();
+        auto end = positions->end();
+        if(!subtree.isEmpty()) {
+            const auto root = m_positions.constFind(subtree);
+            if(root == m_positions.constEnd())
+                return objects;
+            begin = std::lower_bound(positions->begin(), positions->end(), *root);
+            end = std::lower_bound(begin, positions->end(), m_ends[*root]);
         }
+        for(auto it = begin; it != end; ++it)
+            objects.push_back(m_nodes[*it]);
         return objects;
     }
 
     QJsonObject FigmaParser::delta(const QJsonObject& instance, const QJsonObject& base, const QSet<QString>& ignored, const QHash<QString, std::function<QJsonValue (const QJsonValue&, const QJsonValue&)>>& compares) {
         QJsonObject newObject;
-        for(const auto& k : instance.keys()) {
+        for(auto it = instance.constBegin(); it != instance.constEnd(); ++it) {
+            const auto k = it.key();
             if(ignored.contains(k))
                 continue;
-            if(!base.contains(k)) {
-                 newObject.insert(k, instance[k]);
-            } else if(compares.contains(k)) {
-                const QJsonValue ret = compares[k](base[k], instance[k]);
+            const auto baseIt = base.constFind(k);
+            if(baseIt == base.constEnd()) {
+                 newObject.insert(k, it.value());
+            } else if(const auto compare = compares.constFind(k); compare != compares.constEnd()) {
+                const QJsonValue ret = (*compare)(baseIt.value(), it.value());
                 if(ret.type() != QJsonValue::Null) {
                      newObject.insert(k, ret);
                 }
-            } else if(base[k] != instance[k]) {
-                newObject.insert(k, instance[k]);
+            } else if(baseIt.value() != it.value()) {
+                newObject.insert(k, it.value());
             }
         }
         //These items get wiped off, but are needed later - so we put them back
@@ -246,6 +489,11 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
 
     std::optional<FigmaParser::Element> FigmaParser::getElement(const QJsonObject& obj) {
         m_parent = &obj;
+#ifndef NO_CONCURRENT
+        auto sizes = std::make_shared<QHash<QString, int>>();
+        subtreeSizes(obj, *sizes);
+        m_subtreeSizes = sizes;
+#endif
         auto bytes = parse(obj, 1);
         if(!bytes)
             return std::nullopt;
@@ -254,12 +502,18 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
                 validFileName(obj["name"].toString(), false),
                 obj["id"].toString(),
                 obj["type"].toString(),
-                std::move(bytes.value()),
+                bytes->toByteArray(),
                 std::move(ids));
     }
 
-    QString FigmaParser::tabs(int intendents) const {
-        return QString(m_intendent).repeated(intendents);
+    QByteArray FigmaParser::tabs(int intendents) const {
+        return Emitter::tabs(intendents);
+    }
+
+    FigmaParser::Output FigmaParser::output(const QByteArray& bytes) {
+        auto out = m_emitter.output();
+        out += bytes;
+        return out;
     }
 
 #if 0
@@ -323,7 +577,7 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
          out += intendent + type + " {\n";
          Q_ASSERT(obj.contains("type") && obj.contains("id"));
          out += intendent1 + "id: " + qmlId(obj["id"].toString()) + "\n";
-         out += intendent1 + "objectName:\"" + obj["name"].toString().replace("\"", "\\\"") + "\"\n";
+         out += intendent1 + "objectName:\"" + toQmlString(obj["name"].toString()) + "\"\n";
          return out;
      }
 
@@ -481,7 +735,7 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
     }
 
     EByteArray FigmaParser::makeImageSource(const QString& image, bool isRendering, int intendents, const QString& placeHolder) {
-        QByteArray out;
+        auto out = output();
         auto imageData = m_data.imageData(image, isRendering);
         if(imageData.isEmpty()) {
             if(placeHolder.isEmpty()) {
@@ -496,16 +750,12 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
             }
         }
 
-        for(auto  pos = 1024 ; pos < imageData.length(); pos+= 1024) { //helps source viewer....
-            imageData.insert(pos, "\" +\n \"");
-        }
-
         out += tabs(intendents) + "source: \"" + imageData + "\"\n";
         return out;
     }
 
     EByteArray FigmaParser::makeImageRef(const QString& image, int intendents) {
-        QByteArray out;
+        auto out = output();
         const auto intendent = tabs(intendents + 1);
         out += tabs(intendents) + "Image {\n";
         out += intendent + "anchors.fill: parent\n";
@@ -517,7 +767,7 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
     }
 
     EByteArray FigmaParser::makeFill(const QJsonObject& obj, int intendents) {
-        QByteArray out;
+        auto out = output();
         const auto invisible = obj.contains("visible") && !obj["visible"].toBool();
         if(obj.contains("color")) {
             const auto color = obj["color"].toObject();
@@ -536,7 +786,7 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
     }
 
     EByteArray FigmaParser::makeVector(const QJsonObject& obj, int intendents) {
-        QByteArray out;
+        auto out = output();
         out += makeExtents(obj, intendents);
         const auto fills = obj["fills"].toArray();
         if(fills.size() > 0) {
@@ -617,7 +867,7 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
     }
 
     EByteArray FigmaParser::makePlainItem(const QJsonObject& obj, int intendents) {
-         QByteArray out;
+         auto out = output();
          out += makeItem("Rectangle", obj, intendents); //TODO: set to item
          APPENDERR(out, makeFill(obj, intendents));
          out += makeExtents(obj, intendents);
@@ -638,39 +888,63 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
         }
 
         out += intendent + "PathSvg {\n";
-        out += intendent1 + "path: \"" + path["path"].toString() + "\"\n";
+        out += intendent1 + "path: \"" + toQmlString(path["path"].toString()) + "\"\n";
         out += intendent + "} \n";
         return out;
     }
 
-    EByteArray FigmaParser::parse(const QJsonObject& obj, int intendents) {
-        const auto type = obj["type"].toString();
-        const QHash<QString, std::function<EByteArray (const QJsonObject&, int)> > parsers {
-            {"RECTANGLE", std::bind(&FigmaParser::parseVector, this, std::placeholders::_1, std::placeholders::_2)},
-            {"TEXT", std::bind(&FigmaParser::parseText, this, std::placeholders::_1, std::placeholders::_2)},
-            {"COMPONENT", std::bind(&FigmaParser::parseComponent, this, std::placeholders::_1, std::placeholders::_2)},
-            {"BOOLEAN_OPERATION", std::bind(&FigmaParser::parseBooleanOperation, this, std::placeholders::_1, std::placeholders::_2)},
-            {"INSTANCE", std::bind(&FigmaParser::parseInstance, this, std::placeholders::_1, std::placeholders::_2)},
-            {"ELLIPSE", std::bind(&FigmaParser::parseVector, this, std::placeholders::_1, std::placeholders::_2)},
-            {"VECTOR", std::bind(&FigmaParser::parseVector, this, std::placeholders::_1, std::placeholders::_2)},
-            {"LINE", std::bind(&FigmaParser::parseVector, this, std::placeholders::_1, std::placeholders::_2)},
-            {"REGULAR_POLYGON", std::bind(&FigmaParser::parseVector, this, std::placeholders::_1, std::placeholders::_2)},
-            {"STAR", std::bind(&FigmaParser::parseVector, this, std::placeholders::_1, std::placeholders::_2)},
-            {"GROUP", std::bind(&FigmaParser::parseFrame, this, std::placeholders::_1, std::placeholders::_2)},
-            {"FRAME", std::bind(&FigmaParser::parseFrame, this, std::placeholders::_1, std::placeholders::_2)},
-            {"COMPONENT_SET", std::bind(&FigmaParser::parseFrame, this, std::placeholders::_1, std::placeholders::_2)},
-            {"SLICE", std::bind(&FigmaParser::parseSkip, this, std::placeholders::_1, std::placeholders::_2)},
-            {"STAMP", std::bind(&FigmaParser::parseSkip, this, std::placeholders::_1, std::placeholders::_2)},
-            {"STICKY", std::bind(&FigmaParser::parseSkip, this, std::placeholders::_1, std::placeholders::_2)},
-            {"SHAPE_WITH_TEXT", std::bind(&FigmaParser::parseSkip, this, std::placeholders::_1, std::placeholders::_2)},
-            {"NONE", [this](const QJsonObject& o, int i){return makePlainItem(o, i);}}
+    // type names are mapped once, parse is called for every node
+    std::optional<FigmaParser::NodeType> FigmaParser::nodeType(const QJsonObject& obj) {
+        static const QHash<QString, NodeType> types {
+            {"RECTANGLE", NodeType::Vector},
+            {"TEXT", NodeType::Text},
+            {"COMPONENT", NodeType::Component},
+            {"BOOLEAN_OPERATION", NodeType::Boolean},
+            {"INSTANCE", NodeType::Instance},
+            {"ELLIPSE", NodeType::Vector},
+            {"VECTOR", NodeType::Vector},
+            {"LINE", NodeType::Vector},
+            {"REGULAR_POLYGON", NodeType::Vector},
+            {"STAR", NodeType::Vector},
+            {"GROUP", NodeType::Frame},
+            {"FRAME", NodeType::Frame},
+            {"COMPONENT_SET", NodeType::Frame},
+            {"SLICE", NodeType::Skip},
+            {"STAMP", NodeType::Skip},
+            {"STICKY", NodeType::Skip},
+            {"SHAPE_WITH_TEXT", NodeType::Skip},
+            {"NONE", NodeType::Plain}
         };
-        if(!parsers.contains(type)) {
-            ERR(QString("Non supported object type:\"%1\"").arg(type))
+        const auto it = types.find(obj["type"].toString());
+        if(it == types.end())
+            return std::nullopt;
+        return *it;
+    }
+
+    EByteArray FigmaParser::parse(const QJsonObject& obj, int intendents) {
+        const auto type = nodeType(obj);
+        if(!type) {
+            ERR(QString("Non supported object type:\"%1\"").arg(obj["type"].toString()))
         }
         if(isRendering(obj))
             return parseRendered(obj, intendents);
-        return parsers[type](obj, intendents);
+        if(*type == NodeType::Frame && m_components && m_parent != &obj) { // a component itself is not replaced
+            const auto comp = m_components->value(obj["id"].toString());
+            if(comp)
+                return parseRepeated(obj, *comp, intendents);
+        }
+        switch(*type) {
+        case NodeType::Vector: return parseVector(obj, intendents);
+        case NodeType::Text: return parseText(obj, intendents);
+        case NodeType::Component: return parseComponent(obj, intendents);
+        case NodeType::Boolean: return parseBooleanOperation(obj, intendents);
+        case NodeType::Instance: return parseInstance(obj, intendents);
+        case NodeType::Frame: return parseFrame(obj, intendents);
+        case NodeType::Skip: return parseSkip(obj, intendents);
+        case NodeType::Plain: return makePlainItem(obj, intendents);
+        }
+        Q_UNREACHABLE();
+        return std::nullopt;
     }
 
     bool FigmaParser::isGradient(const QJsonObject& obj) const {
@@ -697,7 +971,7 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
     }
 
     EByteArray FigmaParser::makeImageMaskData(const QString& imageRef, const QJsonObject& obj, int intendents, const QString& sourceId, const QString& maskSourceId) {
-        QByteArray out;
+        auto out = output();
         const auto intendent = tabs(intendents);
         const auto intendent1 = tabs(intendents + 1);
 
@@ -746,7 +1020,7 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
 
      QByteArray FigmaParser::makeAntialising(int intendents) const {
          return (m_flags & AntializeShapes) ?
-            (tabs(intendents) + "antialiasing: true\n").toLatin1() : QByteArray();
+            tabs(intendents) + "antialiasing: true\n" : QByteArray();
      }
 
      /*
@@ -771,7 +1045,7 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
      }
 
      EByteArray FigmaParser::makeVectorNormalFill(const QString& image, const QJsonObject& obj, int intendents) {
-         QByteArray out;
+         auto out = output();
          const auto intendent = tabs(intendents);
          const auto intendent1 = tabs(intendents + 1);
 
@@ -798,12 +1072,12 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
 
     EByteArray FigmaParser::makeVectorNormal(const QJsonObject& obj, int intendents) {
         const auto image = imageFill(obj);
-        return image ? makeVectorNormalFill(*image, obj, intendents) : makeVectorNormalFill(obj, intendents);
+        return image ? makeVectorNormalFill(*image, obj, intendents) : output(makeVectorNormalFill(obj, intendents));
     }
 
     QByteArray FigmaParser::makeVectorInsideFill(const QJsonObject& obj, int intendents) {
         QByteArray out;
-        out += tabs(intendents - 1) + "// QML (SVG) supports only center borders, thus an extra mask is created for " + obj["strokeAlign"].toString()  + "\n";
+        out += tabs(intendents - 1) + "// QML (SVG) supports only center borders, thus an extra mask is created for " + toQmlString(obj["strokeAlign"].toString())  + "\n";
         out += makeItem("Item", obj, intendents);
         out += makeExtents(obj, intendents);
         const auto borderSourceId =  "borderSource_" + qmlId(obj["id"].toString());
@@ -858,8 +1132,8 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
     }
 
     EByteArray FigmaParser::makeVectorInsideFill(const QString& image, const QJsonObject& obj, int intendents) {
-        QByteArray out;
-        out += tabs(intendents - 1) + "// QML (SVG) supports only center borders, thus an extra mask is created for " + obj["strokeAlign"].toString()  + "\n";
+        auto out = output();
+        out += tabs(intendents - 1) + "// QML (SVG) supports only center borders, thus an extra mask is created for " + toQmlString(obj["strokeAlign"].toString())  + "\n";
         out += makeItem("Item", obj, intendents);
         out += makeExtents(obj, intendents);
 
@@ -925,13 +1199,13 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
 
     EByteArray FigmaParser::makeVectorInside(const QJsonObject& obj, int intendentsBase) {
         const auto image = imageFill(obj);
-        return image ? makeVectorInsideFill(*image, obj, intendentsBase) : makeVectorInsideFill(obj, intendentsBase);
+        return image ? makeVectorInsideFill(*image, obj, intendentsBase) : output(makeVectorInsideFill(obj, intendentsBase));
     }
 
     QByteArray FigmaParser::makeVectorOutsideFill(const QJsonObject& obj, int intendents) {
         QByteArray out;
         const auto borderWidth = obj["strokeWeight"].toDouble();
-        out += tabs(intendents - 1) + "// QML (SVG) supports only center borders, thus an extra mask is created for " + obj["strokeAlign"].toString()  + "\n";
+        out += tabs(intendents - 1) + "// QML (SVG) supports only center borders, thus an extra mask is created for " + toQmlString(obj["strokeAlign"].toString())  + "\n";
         out += makeItem("Item", obj, intendents);
         out += makeExtents(obj, intendents, {-borderWidth, -borderWidth, borderWidth * 2., borderWidth * 2.}); //since borders shall fit in we must expand (otherwise the mask is not big enough, it always clips)
 
@@ -1016,9 +1290,9 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
     }
 
     EByteArray FigmaParser::makeVectorOutsideFill(const QString& image, const QJsonObject& obj, int intendents) {
-        QByteArray out;
+        auto out = output();
         const auto borderWidth = obj["strokeWeight"].toDouble();
-        out += tabs(intendents - 1) + "// QML (SVG) supports only center borders, thus an extra mask is created for " + obj["strokeAlign"].toString()  + "\n";
+        out += tabs(intendents - 1) + "// QML (SVG) supports only center borders, thus an extra mask is created for " + toQmlString(obj["strokeAlign"].toString())  + "\n";
         out += makeItem("Item", obj, intendents);
         out += makeExtents(obj, intendents, {-borderWidth, -borderWidth, borderWidth * 2., borderWidth * 2.}); //since borders shall fit in we must expand (otherwise the mask is not big enough, it always clips)
 
@@ -1109,7 +1383,7 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
 
     EByteArray FigmaParser::makeVectorOutside(const QJsonObject& obj, int intendentsBase) {
         const auto image = imageFill(obj);
-        return image ? makeVectorOutsideFill(*image, obj, intendentsBase) : makeVectorOutsideFill(obj, intendentsBase);
+        return image ? makeVectorOutsideFill(*image, obj, intendentsBase) : output(makeVectorOutsideFill(obj, intendentsBase));
     }
 
 
@@ -1131,7 +1405,7 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
     QJsonObject FigmaParser::toQMLTextStyles(const QJsonObject& obj) const {
         QJsonObject styles;
         const auto resolvedFunction = m_data.fontInfo(obj["fontFamily"].toString());
-        styles.insert("font.family", QString("\"%1\"").arg(resolvedFunction));
+        styles.insert("font.family", "\"" + toQmlString(resolvedFunction) + "\"");
         styles.insert("font.italic", QString(obj["italic"].toBool() ? "true" : "false"));
         styles.insert("font.pixelSize", QString::number(static_cast<int>(std::floor(obj["fontSize"].toDouble()))));
         styles.insert("font.weight", QString(fontWeight(obj["fontWeight"].toDouble())));
@@ -1177,7 +1451,7 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
     }
 
     EByteArray FigmaParser::parseStyle(const QJsonObject& obj, int intendents) {
-         QByteArray out;
+         auto out = output();
          const auto intendent = tabs(intendents);
          const auto styles = toQMLTextStyles(obj);
          for(const auto& k : styles.keys()) {
@@ -1210,26 +1484,45 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
         return false;
     }
 
+    // follows what parse would request, but without parsing
+    void FigmaParser::collectResources(const QJsonObject& obj, Resources& resources) const {
+        if(isRendering(obj)) {
+            const auto invisible = obj.contains("visible") && !obj["visible"].toBool();
+            if(!invisible)
+                resources.renderings.insert(obj["id"].toString());
+            return;
+        }
+        const auto image = imageFill(obj);
+        if(image)
+            resources.images.insert(*image);
+        if(obj["type"] == "BOOLEAN_OPERATION" && !(m_flags & Flags::BreakBooleans))
+            return;
+        const auto children = obj["children"].toArray();
+        for(const auto& child : children)
+            collectResources(child.toObject(), resources);
+    }
+
     EByteArray FigmaParser::parseText(const QJsonObject& obj, int intendents) {
-        QByteArray out;
+        auto out = output();
         out += makeItem("Text", obj, intendents);
         APPENDERR(out, makeVector(obj, intendents));
         const auto intendent = tabs(intendents);
         out += intendent + "wrapMode: TextEdit.WordWrap\n";
-        out += intendent + "text:\"" + obj["characters"].toString() + "\"\n";
+        out += intendent + "text:\"" + toQmlString(obj["characters"].toString()) + "\"\n";
         APPENDERR(out, parseStyle(obj["style"].toObject(), intendents));
         out += tabs(intendents - 1) + "}\n";
         return out;
      }
 
-    QByteArray FigmaParser::parseSkip(const QJsonObject& obj, int intendents) {
+    EByteArray FigmaParser::parseSkip(const QJsonObject& obj, int intendents) {
         Q_UNUSED(obj);
         Q_UNUSED(intendents);
-        return QByteArray();
+        return output();
     }
 
      EByteArray FigmaParser::parseFrame(const QJsonObject& obj, int intendents) {
-         QByteArray out = makeItem("Rectangle", obj, intendents);
+         auto out = output();
+         out += makeItem("Rectangle", obj, intendents);
          APPENDERR(out, makeVector(obj, intendents));
          const auto intendent = tabs(intendents);
          if(obj.contains("cornerRadius")) {
@@ -1252,7 +1545,8 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
          if(!(m_flags & Flags::ParseComponent)) {
              return parseInstance(obj, intendents);
         } else {
-             QByteArray out = makeItem("Rectangle", obj, intendents);
+             auto out = output();
+             out += makeItem("Rectangle", obj, intendents);
              APPENDERR(out, makeVector(obj, intendents));
              const auto intendent = tabs(intendents);
              if(obj.contains("cornerRadius")) {
@@ -1260,14 +1554,15 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
              }
              out += intendent + "clip: " + (obj["clipsContent"].toBool() ? "true" : "false") + " \n";
 
-             const auto children = parseChildrenItems(obj, intendents);
+             auto children = parseChildrenItems(obj, intendents);
              if(!children)
                  return std::nullopt;
              const auto keys = children->keys();
              for(const auto& key : keys) {
                  const auto id = delegateName(key);
                  const auto sname = QString(id[0]).toUpper() + id.mid(1);
-                 out += intendent + QString("property Component %1: ").arg(id).toLatin1() + (*children)[key];
+                 out += intendent + QString("property Component %1: ").arg(id).toLatin1();
+                 out += std::move((*children)[key]);
                  out += intendent + QString("property Item i_%1\n").arg(id);
                  out += intendent + QString("property matrix4x4 %1_transform: Qt.matrix4x4(%2)\n").arg(id).arg(QString("Nan ").repeated(16).split(' ').join(",")).toLatin1();
                  out += intendent + QString("on%1_transformChanged: {if(i_%2 && i_%2.transform != %2_transform) i_%2.transform = %2_transform;}\n").arg(sname, id).toLatin1();
@@ -1301,7 +1596,7 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
 
      EByteArray FigmaParser::parseBooleanOperationUnion(const QJsonObject& obj, int intendents, const QString& sourceId, const QString& maskSourceId)
      {
-         QByteArray out;
+         auto out = output();
          const auto intendent = tabs(intendents);
          const auto intendent1 = tabs(intendents + 1);
          out += intendent + "Rectangle {\n";
@@ -1332,7 +1627,7 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
      }
 
      EByteArray FigmaParser::parseBooleanOperationSubtract(const QJsonObject& obj, const QJsonArray& children, int intendents, const QString& sourceId, const QString& maskSourceId) {
-         QByteArray out;
+         auto out = output();
          const auto intendent = tabs(intendents);
          const auto intendent1 = tabs(intendents + 1);
          out += intendent + "Item {\n";
@@ -1384,7 +1679,7 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
      }
 
      EByteArray FigmaParser::parseBooleanOperationIntersect(const QJsonObject& obj, const QJsonArray& children, int intendents, const QString& sourceId, const QString& maskSourceId) {
-         QByteArray out;
+         auto out = output();
 
          const auto intendent = tabs(intendents);
          const auto intendent1 = tabs(intendents + 1);
@@ -1426,7 +1721,7 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
      }
 
      EByteArray FigmaParser::parseBooleanOperationExclude(const QJsonObject& obj, const QJsonArray& children, int intendents, const QString& sourceId, const QString& maskSourceId) {
-         QByteArray out;
+         auto out = output();
 
          const auto intendent = tabs(intendents);
          const auto intendent1 = tabs(intendents + 1);
@@ -1518,7 +1813,7 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
          }
          const auto operation = obj["booleanOperation"].toString();
 
-         QByteArray out;
+         auto out = output();
          out += makeItem("Item", obj, intendents);
          out += makeExtents(obj, intendents);
          //const auto intendent = tabs(intendents);
@@ -1535,7 +1830,7 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
             APPENDERR(out, parseBooleanOperationExclude(obj, children, intendents, sourceId, maskSourceId));
          } else {
              // not supported
-             return QByteArray();
+             return output();
          }
          out += tabs(intendents - 1) + "}\n";
          return out;
@@ -1557,7 +1852,7 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
 
 
      EByteArray FigmaParser::parseRendered(const QJsonObject& obj, int intendents) {
-         QByteArray out;
+         auto out = output();
          out += makeComponentInstance("Item", obj, intendents);
          const auto intendent = tabs(intendents );
          Q_ASSERT(m_parent->contains("absoluteBoundingBox"));
@@ -1597,33 +1892,56 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
          return out;
      }
 
+     EByteArray FigmaParser::parseRepeated(const QJsonObject& obj, const Component& comp, int intendents) {
+         auto out = output();
+         m_componentIds.insert(obj["id"].toString());
+         auto instanceObject = delta(obj, comp.object(), {"children"}, {});
+         instanceObject.insert("type", obj["type"]);
+         instanceObject.insert("id", obj["id"]);
+         //Just dummy to prevent transparent
+         if(obj.contains("fills") && !instanceObject.contains("fills")) {
+             instanceObject.insert("fills", "");
+         }
+         //Just dummy to prevent transparent
+         if(obj.contains("strokes") && !instanceObject.contains("strokes")) {
+             instanceObject.insert("strokes", "");
+         }
+         out += makeItem(comp.name(), instanceObject, intendents);
+         APPENDERR(out, makeVector(instanceObject, intendents));
+         out += tabs(intendents - 1) + "}\n";
+         return out;
+     }
+
      EByteArray FigmaParser::makeInstanceChildren(const QJsonObject& obj, const QJsonObject& comp, int intendents) {
-        QByteArray out;
+        auto out = output();
         const auto compChildren = comp["children"].toArray();
         const auto objChildren = obj["children"].toArray();
-        auto children = parseChildrenItems(obj, intendents);  //const not accepted! bug in VC??
-        if(!children)
-            return std::nullopt;
-        if(compChildren.size() != children->size()) { //TODO: better heuristics what to do if kids count wont match, problem is z-order, but we can do better
-            for(const auto& [k, bytes] : *children)
-                out += bytes;
+        const auto hasMask = std::any_of(objChildren.begin(), objChildren.end(), [](const auto& c) {
+            return c.toObject()["isMask"].toBool();
+        });
+        if(hasMask || compChildren.size() != objChildren.size()) { //TODO: better heuristics what to do if kids count wont match, problem is z-order, but we can do better
+            auto children = parseChildrenItems(obj, intendents);  //const not accepted! bug in VC??
+            if(!children)
+                return std::nullopt;
+            for(auto& [k, bytes] : *children)
+                out += std::move(bytes);
             return out;
         }
-     //   QSet<QString> unmatched = QSet<QString>::fromList(children.keys());
-     //   Q_ASSERT(compChildren.size() == children.size());
-        const auto keys = children->keys();
+        // instance children ids end with the id of the corresponding component child
+        QHash<QString, int> objIndex;
+        for(auto i = 0; i < objChildren.size(); ++i) {
+            const auto key = objChildren[i].toObject()["id"].toString();
+            objIndex.insert(key.mid(key.lastIndexOf(';') + 1), i);
+        }
         const auto intendent = tabs(intendents);
         for(const auto& cc : compChildren) {
             //first we find the corresponsing object child
             const auto cchild = cc.toObject();
             const auto id = cchild["id"].toString();
-            //when it's keys last section  match
-            const auto keyit = std::find_if(keys.begin(), keys.end(), [&id](const auto& key){return key.split(';').last() == id;});
-            Q_ASSERT(keyit != keys.end());
-            //and get its index
-        //    Q_ASSERT(unmatched.contains(*keyit));
-        //    unmatched.remove(*keyit);
-            const auto index = std::distance(keys.begin(), keyit);
+            const auto index = objIndex.value(id, -1);
+            if(index < 0) {
+                ERR("Instance child not found", obj["id"].toString(), id);
+            }
             //here we have it
             const auto objChild = objChildren[index].toObject();
             //Then we compare to to find delta, we ignore absoluteBoundingBox as
@@ -1633,8 +1951,10 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
                                                                                                       }}});
 
             // difference, nothing to override
-            if(deltaObject.isEmpty())
+            if(deltaObject.isEmpty()) {
+                collectComponentIds(objChild); // not parsed, but its components are still needed
                 continue;
+            }
 
             if(deltaObject.size() <= 2
                     && ((deltaObject.size() == 2
@@ -1657,34 +1977,74 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
                     out += intendent + QString("%1_width: %2\n").arg(delegateId).arg(static_cast<int>(size["x"].toDouble()));
                     out += intendent + QString("%1_height: %2\n").arg(delegateId).arg(static_cast<int>(size["y"].toDouble()));
                 }
+                collectComponentIds(objChild);
                 continue;
             }
-            out += intendent + delegateName(id) + ":" + (*children)[*keyit];
+            // only the overridden children are parsed
+            const auto parent = m_parent;
+            m_parent = &obj;
+            auto child = parse(objChild, intendents + 1);
+            m_parent = parent;
+            if(!child)
+                return std::nullopt;
+            out += intendent + delegateName(id) + ":";
+            out += std::move(*child);
         }
         return out;
     }
 
+    void FigmaParser::collectComponentIds(const QJsonObject& obj) {
+        const auto id = obj["id"].toString();
+        if(m_index && m_index->contains(id)) { // instances and components of the subtree are positions in the index
+            for(const auto& instance : m_index->objects("INSTANCE", id)) {
+                const auto componentId = instance["componentId"].toString();
+                if(m_components && m_components->contains(componentId))
+                    m_componentIds.insert(componentId);
+            }
+            if(!(m_flags & Flags::ParseComponent)) {
+                for(const auto& component : m_index->objects("COMPONENT", id)) {
+                    const auto componentId = component["id"].toString();
+                    if(m_components && m_components->contains(componentId))
+                        m_componentIds.insert(componentId);
+                }
+            }
+            return;
+        }
+        const auto t = obj["type"].toString();
+        if(t == "INSTANCE" || (t == "COMPONENT" && !(m_flags & Flags::ParseComponent))) {
+            const auto componentId = (t == "INSTANCE" ? obj["componentId"] : obj["id"]).toString();
+            if(m_components && m_components->contains(componentId))
+                m_componentIds.insert(componentId);
+        }
+        const auto children = obj["children"].toArray();
+        for(const auto& c : children)
+            collectComponentIds(c.toObject());
+    }
+
     QJsonValue FigmaParser::getValue(const QJsonObject& obj, const QString& key) const {
         if(obj.contains(key))
             return obj[key];
         else if(type(obj) == ItemType::Instance) {
-            return getValue((*m_components)[obj["componentId"].toString()]->object(), key);
+            const auto componentId = obj["componentId"].toString();
+            if(m_index && m_index->contains(componentId))
+                return getValue(m_index->object(componentId), key);
+            const auto component = m_components->value(componentId); // components of other files are not in the index
+            return component ? getValue(component->object(), key) : QJsonValue();
         }
         return QJsonValue();
     }
 
      EByteArray FigmaParser::parseInstance(const QJsonObject& obj, int intendents) {
-         QByteArray out;
+         auto out = output();
          const auto isInstance = type(obj) == ItemType::Instance;
          const auto componentId = (isInstance ? obj["componentId"] : obj["id"]).toString();
          m_componentIds.insert(componentId);
 
-         if(!m_components->contains(componentId)) {
+         const auto comp = m_components->value(componentId);
+         if(!comp) {
              ERR("Unexpected component dependency from", obj["id"].toString(), "to", componentId);
          }
 
-         const auto comp = (*m_components)[componentId];
-
          if(!isInstance) {
              out += makeComponentInstance(comp->name(), obj, intendents);
          } else {
@@ -1711,21 +2071,31 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
      }
 
       EByteArray FigmaParser::parseChildren(const QJsonObject& obj, int intendents) {
-          QByteArray out;
-          const auto items = parseChildrenItems(obj, intendents);
+          auto out = output();
+          auto items = parseChildrenItems(obj, intendents);
           if(!items)
               return std::nullopt;
-          for(const auto& [k, bytes] : *items)
-              out += bytes;
+          for(auto& [k, bytes] : *items)
+              out += std::move(bytes);
           return out;
       }
 
-    std::optional<OrderedMap<QString, QByteArray>> FigmaParser::parseChildrenItems(const QJsonObject& obj, int intendents) {
-        OrderedMap<QString, QByteArray> childrenItems;
+    std::optional<OrderedMap<QString, FigmaParser::Output>> FigmaParser::parseChildrenItems(const QJsonObject& obj, int intendents) {
+        OrderedMap<QString, Output> childrenItems;
         const auto parent = m_parent;
+#ifndef NO_CONCURRENT
+        struct Subtree {
+            QString id;
+            std::optional<QByteArray> bytes;
+            QSet<QString> componentIds;
+            QString error;
+            std::unique_ptr<SubtreeTask> task;
+        };
+        std::list<Subtree> subtrees; // tasks are joined by their destructor on early returns
+#endif
         if(obj.contains("children")) {
             bool hasMask = false;
-            QByteArray out;
+            auto out = output();
             auto children = obj["children"].toArray();
             for(const auto& c : children) {
                 m_parent = & obj;
@@ -1754,26 +2124,81 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
                     out += intendent1 + "anchors.fill:parent\n";
                     out += intendent1 + "visible:false\n";
                     hasMask = true;
-                } else {
-                    const auto parsed = parse(child, hasMask ? intendents + 2 : intendents + 1);
+                }
+#ifndef NO_CONCURRENT
+                else if(m_subtreeSizes && m_subtreeSizes->contains(child["id"].toString())) {
+                    auto& subtree = subtrees.emplace_back();
+                    subtree.id = child["id"].toString();
+                    childrenItems.insert(subtree.id, Output()); // filled in order when joined
+                    const auto childIntendents = hasMask ? intendents + 2 : intendents + 1;
+                    subtree.task = std::make_unique<SubtreeTask>([this, &subtree, &obj, child, childIntendents]() {
+                        FigmaParser p(m_flags, m_data, m_components, m_index);
+                        p.m_parent = &obj;
+                        p.m_subtreeSizes = m_subtreeSizes;
+                        const auto parsed = p.parse(child, childIntendents);
+                        if(parsed) {
+                            subtree.bytes = parsed->toByteArray(); // the output of p is released with it
+                            subtree.componentIds = p.m_componentIds;
+                        } else {
+                            subtree.error = lastError();
+                        }
+                    });
+                }
+#endif
+                else {
+                    auto parsed = parse(child, hasMask ? intendents + 2 : intendents + 1);
                     if(!parsed)
                         return std::nullopt;
-                    childrenItems.insert(child["id"].toString(), *parsed);
+                    childrenItems.insert(child["id"].toString(), std::move(*parsed));
                 }
             }
+#ifndef NO_CONCURRENT
+            for(auto& subtree : subtrees) {
+                subtree.task->join();
+                if(!subtree.bytes) {
+                    last_parse_error = subtree.error; // error state is per thread
+                    return std::nullopt;
+                }
+                childrenItems[subtree.id] = output(*subtree.bytes);
+                m_componentIds.unite(subtree.componentIds);
+            }
+#endif
             if(hasMask) {
-                for(const auto& [k, bytes]: childrenItems)
-                    out += bytes;
+                for(auto& [k, bytes]: childrenItems)
+                    out += std::move(bytes);
                 out += tabs(intendents + 1) + "}\n";
                 out += tabs(intendents) + "}\n";
                 childrenItems.clear();
-                childrenItems.insert("maskedItem", out);
+                childrenItems.insert("maskedItem", std::move(out));
             }
         }
         m_parent = parent;
         return childrenItems;
     }
 
+    // a child is forked when it splits the work of its parent: the largest child is left
+    // to the parent's own task, so a chain of single large children is never forked
+    int FigmaParser::subtreeSizes(const QJsonObject& obj, QHash<QString, int>& sizes) {
+        const auto children = obj["children"].toArray();
+        std::vector<std::pair<QString, int>> childSizes;
+        childSizes.reserve(children.size());
+        int size = 1;
+        for(const auto& c : children) {
+            const auto child = c.toObject();
+            const auto childSize = subtreeSizes(child, sizes);
+            childSizes.emplace_back(child["id"].toString(), childSize);
+            size += childSize;
+        }
+        const auto largest = std::max_element(childSizes.begin(), childSizes.end(), [](const auto& a, const auto& b) {
+            return a.second < b.second;
+        });
+        for(auto it = childSizes.begin(); it != childSizes.end(); ++it) {
+            if(it != largest && it->second >= ForkNodes)
+                sizes.insert(it->first, it->second);
+        }
+        return size;
+    }
+
     QString FigmaParser::lastError() {
         return last_parse_error;
     }
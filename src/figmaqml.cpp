@@ -12,6 +12,12 @@
 #include <QFontDatabase>
 #include <QFontInfo>
 #include <QStandardPaths>
+#include <QMutex>
+#include <QCryptographicHash>
+#ifdef HAS_QUAZIP
+#include <quazip/quazip.h>
+#include <quazip/quazipfile.h>
+#endif
 #ifdef USE_NATIVE_FONT_DIALOG
 #include <QFontDialog>
 #include <QApplication>
@@ -21,12 +27,12 @@
 
 #ifndef NO_CONCURRENT
 #include <QtConcurrent>
-template <class T> using Future = QFuture<T>;
 namespace Concurrent = QtConcurrent;
-template <class T> using FutureWatcher = QFutureWatcher<T>;
 #endif
 
 #include <QTime>
+#include <algorithm>
+#include <filesystem>
 #define TIMED_START(s)  const auto s = QTime::currentTime();
 #define TIMED_END(s, p) if(m_flags & Timed ) {emit info(toStr("timed", p, s.msecsTo(QTime::currentTime())));}
 
@@ -48,6 +54,7 @@ using namespace std::chrono_literals;
 const QLatin1String qmlViewPath("/qml/");
 const QLatin1String sourceViewPath("/sources/");
 const QLatin1String Images("/images/");
+const QLatin1String ImageResources("images.qrc");
 const QLatin1String FileHeader("//Generated by FigmaQML\n\n");
 
 static int levenshteinDistance(const QString& s1, const QString& s2) {
@@ -78,9 +85,187 @@ enum Format {
     None = 0, JPEG, PNG
 };
 
+// returned in place of a resource that is not yet available, the item is parsed
+// up to the end to request all its resources and then discarded
+const QByteArray PendingData("pending");
+// parsed items refer to images as ImageRef <I|R> imageRef RefEnd, they are
+// resolved when a document is written, so the same parse fits all document types
+const char ImageRef = '\x01';
+const char RefEnd = '\x02';
+
+// the document JSON is parsed and indexed once, and shared by all documents
+// created from the same data
+struct FigmaQml::Parsed {
+    const QByteArray data;
+    const QJsonObject json;
+    const FigmaParser::Index index;
+};
+
+// parsed items are kept over suspended rounds, therefore only the items
+// that were waiting for resources are parsed again when the build resumes
+struct FigmaQml::Build {
+    std::shared_ptr<const Parsed> parsed;
+    unsigned flags = 0;
+    QMap<int, QSet<int>> filter;
+    std::optional<FigmaParser::Components> components;
+    QHash<QString, FigmaParser::Element> componentElements;
+    QHash<QPair<int, int>, FigmaParser::Element> elements;
+    QString error;
+    QHash<QString, QByteArray> componentDigests;
+    QSet<QByteArray> cacheKeys;
+};
+
+// parsed components and elements are kept over builds, an entry is reused when its
+// object, the flags and all the components it uses are unchanged
+struct FigmaQml::ParseCache {
+    struct Entry {
+        FigmaParser::Element element;
+        QHash<QString, QByteArray> components;
+        Resources resources; // requested again when the entry is used
+    };
+    QHash<QByteArray, Entry> entries;
+};
+
+// callbacks of a single component or element parse, parses and their subtrees
+// run concurrently, hence resources that are not available are requested when all are done
+class FigmaQml::ParseTask : public FigmaParserData {
+public:
+    using Parse = std::function<std::optional<FigmaParser::Element> (FigmaParserData&)>;
+    using Done = std::function<void (const FigmaParser::Element&, const Resources&)>;
+    ParseTask(FigmaQml& figmaQml, const Parse& parse, const Done& done) :
+        m_figmaQml(figmaQml), m_parse(parse), m_done(done) {}
+    void run() {
+        if(!m_figmaQml.m_ok || m_figmaQml.m_doCancel)
+            return;
+        m_element = m_parse(*this);
+        if(!m_element)
+            m_error = FigmaParser::lastError(); // error state is per thread
+    }
+    void parseError(const QString& error, bool isFatal) override {
+        QMutexLocker lock(&m_mutex);
+        m_errors.emplace_back(error, isFatal);
+    }
+    QByteArray imageData(const QString& imageRef, bool isRendering) override {
+        const auto resource = isRendering ? Resource::Rendering : Resource::Image;
+        const auto reference = m_figmaQml.imageReference(imageRef, isRendering);
+        QMutexLocker lock(&m_mutex);
+        if(imageRef != FigmaParser::PlaceHolder)
+            m_resources.emplace(imageRef, resource);
+        if(!reference) {
+            m_pending.emplace_back(imageRef, resource);
+            return PendingData;
+        }
+        return reference.value();
+    }
+    QByteArray nodeData(const QString& id) override {
+        const auto node = m_figmaQml.mProvider.cachedNode(id);
+        QMutexLocker lock(&m_mutex);
+        m_resources.emplace(id, Resource::Node);
+        if(!node) {
+            m_pending.emplace_back(id, Resource::Node);
+            return QByteArray();
+        }
+        return node.value();
+    }
+    QString fontInfo(const QString& font) override {
+        static QMutex mutex; // font lookups are few as they are cached
+        QMutexLocker lock(&mutex);
+        return m_figmaQml.fontInfo(font);
+    }
+private:
+    FigmaQml& m_figmaQml;
+    Parse m_parse;
+    Done m_done;
+    std::optional<FigmaParser::Element> m_element;
+    QString m_error;
+    std::vector<std::pair<QString, bool>> m_errors;
+    std::vector<std::pair<QString, Resource>> m_pending;
+    Resources m_resources;
+    QMutex m_mutex;
+    friend class FigmaQml;
+};
+
 FigmaQml::~FigmaQml() {
 }
 
+// document nodes are hashed once when the data is indexed, only the nodes
+// received separately are serialized here
+QByteArray FigmaQml::objectDigest(const QJsonObject& obj) const {
+    const auto digest = m_build->parsed->index.digest(obj["id"].toString());
+    if(!digest.isEmpty())
+        return digest;
+    return QCryptographicHash::hash(QJsonDocument(obj).toJson(QJsonDocument::Compact), QCryptographicHash::Sha1);
+}
+
+QByteArray FigmaQml::cacheKey(const QJsonObject& obj, const QString& componentName) const {
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    const auto flags = m_flags & ~(Timed | EmbedImages | ResourceImages); // images are resolved when written
+    hash.addData(QByteArray::number(flags));
+    hash.addData(componentName.toUtf8());
+    hash.addData(objectDigest(obj));
+    return hash.result();
+}
+
+QByteArray FigmaQml::componentDigest(const FigmaParser::Components& components, const QString& id) {
+    const auto digest = m_build->componentDigests.constFind(id);
+    if(digest != m_build->componentDigests.constEnd())
+        return *digest;
+    const auto component = components.value(id);
+    QByteArray value;
+    if(component) {
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        hash.addData(component->name().toUtf8());
+        hash.addData(objectDigest(component->object()));
+        value = hash.result();
+    }
+    m_build->componentDigests.insert(id, value);
+    return value;
+}
+
+std::optional<FigmaParser::Element> FigmaQml::cached(const QByteArray& key, const FigmaParser::Components& components) {
+    const auto entry = m_parseCache->entries.constFind(key);
+    if(entry == m_parseCache->entries.constEnd())
+        return std::nullopt;
+    for(auto it = entry->components.constBegin(); it != entry->components.constEnd(); ++it) {
+        if(componentDigest(components, it.key()) != it.value())
+            return std::nullopt;
+    }
+    // the parser is not run, hence the resources the output refers to are asked here
+    bool missing = false;
+    for(const auto& [id, resource] : entry->resources) {
+        if(resource == Resource::Node) {
+            if(!mProvider.cachedNode(id)) {
+                mProvider.getNode(id);
+                missing = true;
+            }
+        } else if(!imageReference(id, resource == Resource::Rendering)) {
+            requestImage(id, resource == Resource::Rendering);
+            missing = true;
+        }
+    }
+    if(missing)
+        suspend(); // the output is kept, it is written when the resources are received
+    m_build->cacheKeys.insert(key);
+    return entry->element;
+}
+
+void FigmaQml::cache(const QByteArray& key, const FigmaParser::Element& element, const FigmaParser::Components& components, const Resources& resources) {
+    ParseCache::Entry entry{element, {}, resources};
+    for(const auto& id : element.components())
+        entry.components.insert(id, componentDigest(components, id));
+    m_parseCache->entries.insert(key, entry);
+    m_build->cacheKeys.insert(key);
+}
+
+void FigmaQml::pruneCache() {
+    for(auto it = m_parseCache->entries.begin(); it != m_parseCache->entries.end();) {
+        if(m_build->cacheKeys.contains(it.key()))
+            ++it;
+        else
+            it = m_parseCache->entries.erase(it);
+    }
+}
+
 int FigmaQml::canvasCount() const {
     return m_uiDoc ? m_uiDoc->size() : 0;
 }
@@ -152,67 +337,229 @@ QString FigmaQml::validFileName(const QString& name) {
    return FigmaParser::makeFileName(name);
 }
 
-bool FigmaQml::saveAllQML(const QString& folderName) {
-#ifdef Q_OS_WINDOWS
-    QDir d(folderName.startsWith('/') ? folderName.mid(1) : folderName);
+// A file of the export, written or linked by an I/O task. Files that already
+// have the same content are not touched, so that builds that depend on the
+// exported files stay incremental.
+struct FigmaQml::ExportFile {
+    enum class Result {Written, Unchanged, Failed};
+    QString path;
+    QByteArray data;
+    QString source; // linked or copied instead of data
+    QString imageRef = {}; // the image of the source, read from the provider by the zip export
+    bool isRendering = false;
+    Result result = Result::Failed;
+    QString error = {};
+    void run() {
+        result = source.isEmpty() ? write() : link();
+    }
+private:
+    static bool sameContent(QFile& file, const QByteArray& data) {
+        return file.size() == data.size() && file.open(QIODevice::ReadOnly) && file.readAll() == data;
+    }
+    Result write() {
+        QFile current(path);
+        if(current.exists() && sameContent(current, data))
+            return Result::Unchanged;
+        QSaveFile file(path);
+        if(!file.open(QIODevice::WriteOnly) || file.write(data) < 0 || !file.commit()) {
+            error = file.errorString();
+            return Result::Failed;
+        }
+        return Result::Written;
+    }
+    Result link() {
+        if(!QFile::exists(source)) {
+            error = QString("%1 not found").arg(source);
+            return Result::Failed;
+        }
+        const std::filesystem::path from(source.toStdU16String());
+        const std::filesystem::path to(path.toStdU16String());
+        std::error_code ec;
+        if(QFile::exists(path)) {
+            if(std::filesystem::equivalent(from, to, ec))
+                return Result::Unchanged;
+            QFile sourceFile(source);
+            QFile current(path);
+            if(sourceFile.open(QIODevice::ReadOnly) && sameContent(current, sourceFile.readAll()))
+                return Result::Unchanged;
+            current.close();
+            if(!current.remove()) {
+                error = current.errorString();
+                return Result::Failed;
+            }
+        }
+        ec.clear();
+        std::filesystem::create_hard_link(from, to, ec); // images are not modified, hence sharing is safe
+        if(!ec)
+            return Result::Written;
+        QFile file(source); // e.g. different file systems
+        if(!file.copy(path)) {
+            error = file.errorString();
+            return Result::Failed;
+        }
+        return Result::Written;
+    }
+};
+
+bool FigmaQml::exportFiles(std::vector<ExportFile>& files, const QString& folder) {
+#ifdef NO_CONCURRENT
+    for(auto& file : files)
+        file.run();
 #else
-    QDir d(folderName);
+    Concurrent::blockingMap(files, [](ExportFile& file) {file.run();});
 #endif
-    if(!ensureDirExists(d.absolutePath())) {
-        return false;
+    int written = 0;
+    int unchanged = 0;
+    for(const auto& file : files) {
+        switch(file.result) {
+        case ExportFile::Result::Failed:
+            emit error(QString("Failed to write \"%1\" \"%2\"").arg(file.error, file.path));
+            return false;
+        case ExportFile::Result::Written:
+            ++written;
+            break;
+        case ExportFile::Result::Unchanged:
+            ++unchanged;
+            break;
+        }
     }
+    emit info(QString("%1 files written into %2, %3 unchanged").arg(written).arg(folder).arg(unchanged));
+    return true;
+}
+
+// paths are relative to the export folder
+bool FigmaQml::exportList(std::vector<ExportFile>& files) {
     QSet<QString> componentNames;
     for(const auto& c : *m_sourceDoc) {
         for(const auto& e : *c) {
             const auto sourceName = FigmaParser::makeFileName(c->name());
-            const auto fullname = QString("%1/%2_%3.qml").arg(d.absolutePath(), sourceName, e->name());
-            QSaveFile file(fullname);
-            if(!file.open(QIODevice::WriteOnly)) {
-                emit error(QString("Failed to write %1 %2 %3 %4").arg(file.errorString(), fullname, d.absolutePath(), e->name()));
-                return false;
-            }
-            if(e->data().length() == 0 || file.write(e->data()) < 0) {
-                emit error(QString("Failed to write %1 %2 %3 %4").arg(file.errorString(), fullname, d.absolutePath(), e->name()));
+            const auto name = QString("%1_%2.qml").arg(sourceName, e->name());
+            if(e->data().length() == 0) {
+                emit error(QString("Failed to write %1 %2").arg(name, e->name()));
                 return false;
             }
+            files.push_back({name, e->data(), {}});
             const auto elementComponents = m_sourceDoc->components(e->name());
             componentNames.unite(QSet(elementComponents.begin(), elementComponents.end()));
-            file.commit();
         }
     }
 
     for(const auto& componentName : componentNames) {
         Q_ASSERT(componentName.endsWith(FIGMA_SUFFIX));
-        const auto fullname = QString("%1/%2.qml").arg(d.absolutePath(), componentName);
-        QSaveFile file(fullname);
-        if(!file.open(QIODevice::WriteOnly)) {
-            emit error(QString("Failed to write \"%1\" \"%2\" \"%3\" \"%4\"").arg(file.errorString(), fullname, d.absolutePath(), componentName));
-            return false;
-        }
-
+        const auto name = QString("%1.qml").arg(componentName);
         if(!m_sourceDoc->containsComponent(componentName)) {
             emit error(QString("Failed to find \"%1\" on write").arg(componentName));
             return false;
         }
 
         const auto cd = m_sourceDoc->component(componentName);
-        if(cd.length() == 0 || file.write(cd) < 0) {
-            emit error(QString("Failed to write \"%1\" \"%2\" \"%3\" \"%4\"").arg(file.errorString(), fullname, d.absolutePath(), componentName));
+        if(cd.length() == 0) {
+            emit error(QString("Failed to write \"%1\" \"%2\"").arg(name, componentName));
             return false;
         }
-        file.commit();
+        files.push_back({name, cd, {}});
     }
 
-    if(!saveImages(d.absolutePath() + Images))
+    // images are linked from where they are staged, or read from the provider into a zip
+    for(auto it = m_imageFiles.constBegin(); it != m_imageFiles.constEnd(); ++it)
+        files.push_back({Images.mid(1) + it->name, {}, it->path + it->name, it.key(), it->isRendering});
+
+    if((m_flags & ResourceImages) && !m_imageFiles.isEmpty()) { // the images are referred as qrc:/images/...
+        QByteArray qrc("<RCC>\n    <qresource prefix=\"/\">\n");
+        for(const auto& file : files) {
+            if(!file.source.isEmpty())
+                qrc += "        <file>" + file.path.toUtf8() + "</file>\n";
+        }
+        qrc += "    </qresource>\n</RCC>\n";
+        files.push_back({ImageResources, qrc, {}});
+    }
+    return true;
+}
+
+bool FigmaQml::saveAllQML(const QString& folderName) {
+#ifdef Q_OS_WINDOWS
+    QDir d(folderName.startsWith('/') ? folderName.mid(1) : folderName);
+#else
+    QDir d(folderName);
+#endif
+    if(!ensureDirExists(d.absolutePath()) || !ensureDirExists(d.absolutePath() + Images)) {
+        return false;
+    }
+    std::vector<ExportFile> files;
+    if(!exportList(files))
+        return false;
+    for(auto& file : files)
+        file.path = d.absolutePath() + '/' + file.path;
+    return exportFiles(files, d.absolutePath());
+}
+
+bool FigmaQml::saveAllQMLZip(const QString& zipName) {
+#ifdef HAS_QUAZIP
+    QSaveFile file(zipName); // a failed export leaves the previous zip as it was
+    if(!file.open(QIODevice::WriteOnly)) {
+        emit error(QString("Cannot write %1 %2").arg(zipName, file.errorString()));
+        return false;
+    }
+    if(!writeZip(file, zipName))
+        return false;
+    if(!file.commit()) {
+        emit error(QString("Cannot write %1 %2").arg(zipName, file.errorString()));
+        return false;
+    }
+    return true;
+#else
+    emit error(QString("Cannot write %1, zip export is not built in").arg(zipName));
+    return false;
+#endif
+}
+
+#ifdef HAS_QUAZIP
+// entries are streamed into the device, images come from the provider and as they are
+// already compressed, they are stored as they are
+bool FigmaQml::writeZip(QIODevice& device, const QString& zipName) {
+    std::vector<ExportFile> files;
+    if(!exportList(files))
+        return false;
+    QuaZip zip(&device);
+    zip.setAutoClose(false); // the caller commits or reads the device
+    if(!zip.open(QuaZip::mdCreate)) {
+        emit error(QString("Cannot create zip %1 (%2)").arg(zipName).arg(zip.getZipError()));
+        return false;
+    }
+    for(const auto& file : files) {
+        const auto isImage = !file.imageRef.isEmpty();
+        QuaZipFile entry(&zip);
+        if(!entry.open(QIODevice::WriteOnly, QuaZipNewInfo(file.path), nullptr, 0, isImage ? 0 : Z_DEFLATED)) {
+            emit error(QString("Cannot add %1 to %2 (%3)").arg(file.path, zipName).arg(entry.getZipError()));
+            return false;
+        }
+        if(isImage) {
+            const auto image = file.isRendering ? mProvider.cachedRendering(file.imageRef) : mProvider.cachedImage(file.imageRef);
+            if(!image) {
+                emit error(toStr("Cannot read image", file.imageRef));
+                return false;
+            }
+            entry.write(std::get<0>(image.value()));
+        } else
+            entry.write(file.data);
+        entry.close();
+        if(entry.getZipError() != ZIP_OK) {
+            emit error(QString("Failed to write %1 to %2 (%3)").arg(file.path, zipName).arg(entry.getZipError()));
+            return false;
+        }
+    }
+    zip.close();
+    if(zip.getZipError() != ZIP_OK) {
+        emit error(QString("Failed to write %1 (%2)").arg(zipName).arg(zip.getZipError()));
         return false;
-    emit info(QString("%1 files written into %2").arg(m_imageFiles.size() + componentNames.count()
-                                                      + std::accumulate(m_sourceDoc->begin(), m_sourceDoc->end(), 0, [](const auto &a, const auto& c){return a + c->size();}))
-              .arg(d.absolutePath()));
+    }
+    emit info(QString("%1 files written into %2").arg(files.size()).arg(zipName));
     return true;
 }
+#endif
 
 QUrl FigmaQml::element() const {
-      return (m_uiDoc && !m_uiDoc->empty()) ?  QUrl::fromLocalFile(QString(m_uiDoc->current().current())) : QUrl();
+      return (m_uiDoc && !m_uiDoc->empty()) ?  QUrl::fromEncoded(m_uiDoc->current().current()) : QUrl();
 }
 
 QByteArray FigmaQml::sourceCode() const {
@@ -220,7 +567,7 @@ QByteArray FigmaQml::sourceCode() const {
 }
 
 FigmaQml::FigmaQml(const QString& qmlDir, const QString& fontFolder, FigmaProvider& provider, QObject *parent) : QObject(parent),
-    m_qmlDir(qmlDir), mProvider(provider), m_imports(defaultImports()), m_fontCache(std::make_unique<FontCache>()), m_fontFolder(fontFolder) {
+    m_qmlDir(qmlDir), mProvider(provider), m_imports(defaultImports()), m_fontCache(std::make_unique<FontCache>()), m_fontFolder(fontFolder), m_parseCache(std::make_unique<ParseCache>()) {
     qmlRegisterUncreatableType<FigmaQml>("FigmaQml", 1, 0, "FigmaQml", "");
     QObject::connect(this, &FigmaQml::currentElementChanged, this, [this]() {
         m_sourceDoc->getCurrent()->setCurrent(m_uiDoc->getCurrent()->currentIndex());
@@ -241,6 +588,7 @@ FigmaQml::FigmaQml(const QString& qmlDir, const QString& fontFolder, FigmaProvid
     });
 
     const auto fontFolderChanged = [this]() {
+        m_parseCache->entries.clear(); // fonts may resolve differently
         const QDir fontFolder(m_fontFolder);
         if(!fontFolder.exists())
             emit warning(QString("Folder \"%1\", not found").arg(m_fontFolder));
@@ -372,36 +720,6 @@ QByteArray FigmaQml::prettyData(const QByteArray& data) const {
     return bytes;
 }
 
-bool FigmaQml::saveImages(const QString &folder) {
-    if(!ensureDirExists(folder))
-        return false;
-    for(const auto& i : qAsConst(m_imageFiles)) {
-        const QFileInfo file(i.first + i.second);
-        if(!file.exists()) {
-            qDebug() << "invalid filename:" << file.absoluteFilePath() << "not found";
-            emit error(QString("Invalid filename: %1 (not found)").arg(file.absoluteFilePath()));
-            return false;
-        }
-        const auto target = folder + file.fileName();
-        const QFile targetEntry(target);
-        if(targetEntry.exists(target)) {
-            if(targetEntry.size() == file.size()) {
-                // I dont fully get what this means.... how they can be same, error elsewhere?
-                emit warning(QString("Are equal %1 to %2").arg(file.absoluteFilePath(), target));
-                continue;
-             } else {
-                emit error(QString("Cannot replace %1 to %2").arg(file.absoluteFilePath(), target));
-                return false;
-            }
-        }
-        if(!QFile::copy(file.absoluteFilePath(), target)) {
-            emit error(QString("Cannot copy %1 to %2").arg(file.absoluteFilePath(), target));
-            return false;
-        }
-    }
-    return true;
-}
-
 void FigmaQml::addImageFile(const QString& imageRef, bool isRendering) {
     if(isRendering){
         mProvider.getRendering(imageRef);
@@ -416,7 +734,7 @@ void FigmaQml::addImageFile(const QString& imageRef, bool isRendering) {
     }
 }
 
-bool FigmaQml::addImageFileData(const QString& imageRef, const QByteArray& bytes, int mime, bool /*isRendering*/) {
+bool FigmaQml::addImageFileData(const QString& imageRef, const QByteArray& bytes, int mime, bool isRendering) {
     //qDebug() << "FOO: addImageFileData" << imageRef;
     if(bytes.isEmpty())
         return false;
@@ -442,7 +760,7 @@ bool FigmaQml::addImageFileData(const QString& imageRef, const QByteArray& bytes
     //qDebug() << "image saved" << imageRef << filename;
     file.write(bytes);
     file.commit();
-    m_imageFiles.insert(imageRef, {path, imageName});
+    m_imageFiles.insert(imageRef, {path, imageName, isRendering});
     return true;
 }
 
@@ -465,6 +783,7 @@ QVariantMap FigmaQml::fonts() const {
 }
 
 void FigmaQml::setFonts(const QVariantMap& map) {
+  m_parseCache->entries.clear();
   const auto keys = map.keys();
   for (const auto &k : keys) {
     m_fontCache->insert(k, map[k].toString());
@@ -472,23 +791,55 @@ void FigmaQml::setFonts(const QVariantMap& map) {
 }
 
 template<class FigmaDocType>
-void FigmaQml::createDocument(const QJsonObject& json) {
+void FigmaQml::createDocument(const std::shared_ptr<const Parsed>& parsed) {
     m_state = State::Suspend;
     m_busy = true;
     emit busyChanged();
+    if(m_lastBuild && m_lastBuild->parsed == parsed && m_lastBuild->flags == m_flags && m_lastBuild->filter == m_filter) {
+        m_build = std::move(m_lastBuild); // parsed items are only written to another type of document
+    } else {
+        m_build = std::make_unique<Build>();
+        m_build->parsed = parsed;
+        m_build->flags = m_flags;
+        m_build->filter = m_filter;
+        // all known resources of the components and the shown elements are requested before the first parse round
+        std::vector<QJsonObject> elements;
+        const auto canvases = FigmaParser::canvases(parsed->json, *this);
+        if(canvases) {
+            int currentCanvas = 0;
+            for(const auto& c : *canvases) {
+                ++currentCanvas;
+                int currentElement = 0;
+                for(const auto& f : c.elements()) {
+                    ++currentElement;
+                    if(!isFiltered(currentCanvas, currentElement))
+                        elements.push_back(f);
+                }
+            }
+        }
+        const auto resources = FigmaParser::resources(parsed->json, parsed->index, elements, m_flags, *this);
+        mProvider.prefetch(resources.images.values(),
+                           resources.renderings.values(),
+                           resources.nodes.values(),
+                           QSize(m_imageDimensionMax, m_imageDimensionMax));
+    }
+    m_lastBuild.reset();
     auto ctimer = new QTimer(this);
-    QObject::connect(ctimer, &QTimer::timeout, this, [ctimer, this, json](){
+    QObject::connect(ctimer, &QTimer::timeout, this, [ctimer, this, parsed](){
+        const auto& json = parsed->json;
         if(m_state == State::Suspend) {
             if(mProvider.isReady()) {
                 m_state = State::Constructing;
-                auto doc = std::make_unique<FigmaDocType>(m_targetDir, FigmaParser::name(json));
+                auto doc = std::make_unique<FigmaDocType>(FigmaParser::name(json));
                 if(doCreateDocument(*doc, json)) {
                     ctimer->stop();
                     ctimer->deleteLater();
+                    pruneCache(); // entries of removed or changed items are dropped
+                    m_lastBuild = std::move(m_build);
                     Q_ASSERT(FigmaDocType::type() == doc->type());
                     emit figmaDocumentCreated(doc.release());
                 } else if(m_state != State::Suspend) {
-                    parseError(FigmaParser::lastError(), true);
+                    parseError(m_build->error.isEmpty() ? FigmaParser::lastError() : m_build->error, true);
                 }
                 if(m_state != State::Suspend) {
                     m_busy = false;
@@ -498,6 +849,7 @@ void FigmaQml::createDocument(const QJsonObject& json) {
         } else {
             ctimer->stop();
             ctimer->deleteLater();
+            m_build.reset();
             emit figmaDocumentCreated(static_cast<FigmaDocType*>(nullptr));
         }
     });
@@ -511,11 +863,13 @@ void FigmaQml::createDocumentView(const QByteArray &data, bool restoreView) {
     const auto json = object(data);
     if(!json)
         return;
-    cleanDir(m_qmlDir);
     m_imageFiles.clear();
     m_uiDoc.reset();
-    if(!restoreView)
+    m_lastBuild.reset(); // fonts or settings may have changed, hence the view is always parsed
+    if(!restoreView) {
         m_fontCache->clear();
+        m_parseCache->entries.clear();
+    }
     emit isValidChanged();
     emit canvasCountChanged();
     emit elementCountChanged();
@@ -535,19 +889,21 @@ void FigmaQml::createDocumentView(const QByteArray &data, bool restoreView) {
         }
     };
 
-    createDocument<FigmaFileDocument>(*json);
+    createDocument<FigmaFileDocument>(json);
 }
 
 
 void FigmaQml::setFontMapping(const QString& key, const QString& value) {
     qDebug() << "set font" << key << "->" << value;
     m_fontCache->insert(key, value);
+    m_parseCache->entries.clear();
     emit refresh();
     emit fontsChanged();
 }
 
 void FigmaQml::resetFontMappings() {
     m_fontCache->clear();
+    m_parseCache->entries.clear();
     emit refresh();
     emit fontsChanged();
 }
@@ -563,7 +919,7 @@ void FigmaQml::createDocumentSources(const QByteArray &data) {
 
 
 
-    createDocument<FigmaDataDocument>(*json);
+    createDocument<FigmaDataDocument>(json);
 
 }
 
@@ -572,33 +928,33 @@ void FigmaQml::restore(int flags, const QVariantMap& imports) {
     m_imports = imports;
 }
 
-void FigmaQml::cleanDir(const QString& dirName) {
-    QDir dir(dirName);
-    const auto entries = dir.entryInfoList();
-    for(const auto& e : entries) {
-        if(e.isFile() && !dir.remove(e.fileName()))
-            emit error(toStr("Cannot remove", e.fileName()));
-    }
-}
-
-std::optional<QJsonObject> FigmaQml::object(const QByteArray &data) {
+std::shared_ptr<const FigmaQml::Parsed> FigmaQml::object(const QByteArray &data) {
     if(data.isEmpty())
-        return std::nullopt;
+        return nullptr;
+
+    if(m_parsed && m_parsed->data.isSharedWith(data)) // view and sources are created from the same data
+        return m_parsed;
 
+    TIMED_START(t1)
     QJsonParseError parseError;
     const auto json = QJsonDocument::fromJson(data, &parseError);
+    TIMED_END(t1, "JSON")
     if(parseError.error != QJsonParseError::NoError) {
        emit this->error(QString("When reading JSON: %1 at %2")
                 .arg(parseError.errorString())
                 .arg(parseError.offset));
-        return std::nullopt;
+        return nullptr;
     }
 
     if(!json.isObject()) {
         emit error("Object expected");
-        return std::nullopt;
+        return nullptr;
     }
-    return json.object();
+    TIMED_START(t2)
+    const auto object = json.object();
+    m_parsed = std::make_shared<const Parsed>(Parsed{data, object, FigmaParser::Index(object["document"].toObject())});
+    TIMED_END(t2, "Index")
+    return m_parsed;
 }
 
 bool FigmaQml::busy() const {
@@ -652,56 +1008,114 @@ void FigmaQml::parseError(const QString& str, bool isFatal) {
 }
 
 std::optional<std::tuple<QByteArray, int>> FigmaQml::getImage(const QString& imageRef, bool isRendering) {
-    if(isRendering) {
-        const auto imageData = mProvider.cachedRendering(imageRef);
-        if(imageData)
-            return imageData;
+    const auto imageData = isRendering ? mProvider.cachedRendering(imageRef) : mProvider.cachedImage(imageRef);
+    if(imageData)
+        return imageData;
+    requestImage(imageRef, isRendering);
+    return std::nullopt;
+}
+
+void FigmaQml::requestImage(const QString& imageRef, bool isRendering) {
+    if(isRendering)
         mProvider.getRendering(imageRef);
-    } else {
-        const auto imageData = mProvider.cachedImage(imageRef);
-        if(imageData)
-            return imageData;
+    else
         mProvider.getImage(imageRef, QSize(m_imageDimensionMax, m_imageDimensionMax));
-    }
-    return std::nullopt;
 }
 
 void FigmaQml::suspend() {
     m_state = State::Suspend;
 }
 
+// only reads the cache, hence can be called from any thread
+std::optional<QByteArray> FigmaQml::imageReference(const QString& imageRef, bool isRendering) {
+    if(imageRef.contains(QChar(ImageRef)) || imageRef.contains(QChar(RefEnd)))
+        return QByteArray(); // would end the reference early
+    if(imageRef != FigmaParser::PlaceHolder) {
+        const auto imageData = isRendering ? mProvider.cachedRendering(imageRef) : mProvider.cachedImage(imageRef);
+        if(!imageData)
+            return std::nullopt;
+        if(std::get<0>(imageData.value()).isEmpty())
+            return QByteArray();
+    }
+    return ImageRef + QByteArray(isRendering ? "R" : "I") + imageRef.toUtf8() + RefEnd;
+}
+
 QByteArray FigmaQml::imageData(const QString& imageRef, bool isRendering) {
     if(!m_ok || m_doCancel)
         return QByteArray();
-    if(imageRef == FigmaParser::PlaceHolder)
-        return m_brokenPlaceholder;
-    else {
-        if(m_embedImages) {
+    const auto reference = imageReference(imageRef, isRendering);
+    if(!reference) {
+        requestImage(imageRef, isRendering);
+        suspend();
+        return PendingData;
+    }
+    return reference.value();
+}
+
+// long literals are split to lines, that helps the source viewer
+static void appendLines(QByteArray& out, const char* data, qsizetype size) {
+    constexpr qsizetype LineLength = 1024;
+    constexpr char Separator[] = "\" +\n \"";
+    for(qsizetype pos = 0; pos < size; pos += LineLength) {
+        if(pos > 0)
+            out.append(Separator, sizeof(Separator) - 1);
+        out.append(data + pos, std::min(LineLength, size - pos));
+    }
+}
+
+bool FigmaQml::imageSource(const QString& imageRef, bool isRendering, QByteArray& out) {
+    if(imageRef == FigmaParser::PlaceHolder) {
+        appendLines(out, m_brokenPlaceholder.constData(), m_brokenPlaceholder.size());
+    } else if(m_embedImages) {
+        const auto imageData = getImage(imageRef, isRendering); // cached when parsed
+        if(!imageData || std::get<0>(imageData.value()).isEmpty()) {
+            emit error(toStr("Cannot read image", imageRef));
+            return false;
+        }
+        const auto& [bytes, mime] = imageData.value();
+        Q_ASSERT(mime == JPEG || mime == PNG);
+        out += mime == JPEG ? "data:image/jpeg;base64," : "data:image/png;base64,";
+        const auto base64 = bytes.toBase64();
+        appendLines(out, base64.constData(), base64.size());
+    } else {
+        if(!m_imageFiles.contains(imageRef)) {
             const auto imageData = getImage(imageRef, isRendering);
             if(!imageData) {
-                suspend();
-                return{};
+                emit error(toStr("Cannot read image", imageRef));
+                return false;
             }
             const auto& [bytes, mime] = imageData.value();
-            if(bytes.isEmpty())
-                return QByteArray();
-            Q_ASSERT(mime == JPEG || mime == PNG);
-            const QByteArray mimeString = mime == JPEG ? "jpeg" : "png";
-            return "data:image/" + mimeString + ";base64," + bytes.toBase64();
-        } else {
-            if(!m_imageFiles.contains(imageRef)) {
-                const auto imageData = getImage(imageRef, isRendering);
-                if(!imageData) {
-                    suspend();
-                    return{};
-                }
-                const auto& [bytes, mime] = imageData.value();
-                if(!addImageFileData(imageRef, bytes, mime, isRendering))
-                    return {};
-            }
-            return (Images.mid(1) +  m_imageFiles[imageRef].second).toLatin1();
+            if(!addImageFileData(imageRef, bytes, mime, isRendering))
+                return false;
         }
+        if(m_flags & ResourceImages)
+            out += "qrc:/";
+        out += (Images.mid(1) +  m_imageFiles[imageRef].name).toLatin1();
     }
+    return true;
+}
+
+std::optional<QByteArray> FigmaQml::resolveImages(const QByteArray& data) {
+    QByteArray out;
+    qsizetype pos = 0;
+    for(;;) {
+        const auto begin = data.indexOf(ImageRef, pos);
+        if(begin < 0)
+            break;
+        const auto end = data.indexOf(RefEnd, begin);
+        if(end <= begin + 2 || (data[begin + 1] != 'I' && data[begin + 1] != 'R')) {
+            emit error(toStr("Invalid image reference at", begin));
+            return std::nullopt;
+        }
+        out.append(data.constData() + pos, begin - pos);
+        if(!imageSource(QString::fromUtf8(data.constData() + begin + 2, end - begin - 2), data[begin + 1] == 'R', out))
+            return std::nullopt;
+        pos = end + 1;
+    }
+    if(pos == 0)
+        return data;
+    out.append(data.constData() + pos, data.size() - pos);
+    return out;
 }
 
 QByteArray FigmaQml::nodeData(const QString& id) {
@@ -726,22 +1140,118 @@ QString FigmaQml::fontInfo(const QString& requestedFont) {
     return value;
 }
 
+bool FigmaQml::runParseTasks(std::deque<ParseTask>& tasks) {
 #ifdef NO_CONCURRENT
+    for(auto& task : tasks)
+        task.run();
+#else
+    Concurrent::blockingMap(tasks, [](ParseTask& task) {task.run();});
+#endif
+    if(!m_ok || m_doCancel)
+        return false;
+    for(const auto& task : tasks) { // results are handled in order, as the serial parse did
+        if(!task.m_pending.empty()) {
+            for(const auto& [id, resource] : task.m_pending) {
+                if(resource == Resource::Node)
+                    mProvider.getNode(id);
+                else
+                    requestImage(id, resource == Resource::Rendering);
+            }
+            suspend();
+            continue; // parsed again when its resources are available, its messages are reported then
+        }
+        for(const auto& [str, isFatal] : task.m_errors)
+            parseError(str, isFatal);
+        if(!task.m_element) {
+            m_build->error = task.m_error;
+            m_state = State::Failed;
+            return false;
+        }
+        task.m_done(task.m_element.value(), task.m_resources);
+    }
+    return true;
+}
+
+bool FigmaQml::parseComponents(const FigmaParser::Components& components) {
+    std::deque<ParseTask> tasks;
+    for(auto it = components.begin(); it != components.end(); ++it) {
+        const auto& c = it.value();
+        if(it.key() != c->id() || m_build->componentElements.contains(c->id()))
+            continue; // repeated subtrees are aliases of the same component
+        const auto cacheKey = this->cacheKey(c->object(), c->name());
+        const auto element = cached(cacheKey, components);
+        if(element) {
+            m_build->componentElements.insert(c->id(), element.value());
+            continue;
+        }
+        // components depend only on the component objects, not on each other's output
+        tasks.emplace_back(*this, [c, flags = m_flags, &components, &index = m_build->parsed->index](FigmaParserData& data) {
+            return FigmaParser::component(c->object(), flags, data, components, index);
+        }, [this, id = c->id(), cacheKey, &components](const FigmaParser::Element& element, const Resources& resources) {
+            m_build->componentElements.insert(id, element);
+            cache(cacheKey, element, components, resources);
+        });
+    }
+    return runParseTasks(tasks);
+}
+
+bool FigmaQml::isFiltered(int canvas, int element) const {
+    return !m_filter.isEmpty() && (!m_filter.contains(canvas) || !m_filter[canvas].contains(element));
+}
+
+bool FigmaQml::parseElements(const FigmaParser::Canvases& canvases, const FigmaParser::Components& components) {
+    std::deque<ParseTask> tasks;
+    int currentCanvas = 0;
+    for(const auto& c : canvases) {
+        ++currentCanvas;
+        int currentElement = 0;
+        const auto& elements = c.elements();
+        for(const auto& f : elements) {
+            ++currentElement;
+            const auto key = qMakePair(currentCanvas, currentElement);
+            if(m_build->elements.contains(key))
+                continue;
+            if(isFiltered(currentCanvas, currentElement)) {
+                m_build->elements.insert(key, FigmaParser::Element());
+                continue;
+            }
+            const auto cacheKey = this->cacheKey(f);
+            const auto element = cached(cacheKey, components);
+            if(element) {
+                m_build->elements.insert(key, element.value());
+                continue;
+            }
+            tasks.emplace_back(*this, [&f, flags = m_flags, &components, &index = m_build->parsed->index](FigmaParserData& data) {
+                return FigmaParser::element(f, flags, data, components, index);
+            }, [this, key, cacheKey, &components](const FigmaParser::Element& element, const Resources& resources) {
+                m_build->elements.insert(key, element);
+                cache(cacheKey, element, components, resources);
+            });
+        }
+    }
+    return runParseTasks(tasks);
+}
 
 bool FigmaQml::writeComponents(FigmaDocument& doc, const FigmaParser::Components& components, const QByteArray& header) {
 
-    for(const auto& c : components) {
-      const auto component_opt = FigmaParser::component(c->object(), m_flags, *this, components);
-      if(!m_ok || m_doCancel || !component_opt)
+    for(auto it = components.begin(); it != components.end(); ++it) {
+      if(!m_ok || m_doCancel)
           return false;
-      const auto& component = component_opt.value();
+      const auto& c = it.value();
+      if(it.key() != c->id())
+          continue; // repeated subtrees are aliases of the same component
+      Q_ASSERT(m_build->componentElements.contains(c->id()));
+      const auto component = m_build->componentElements.value(c->id());
       if(component.data().isEmpty()) {
           emit error(toStr("Invalid component", component.name()));
           return false;
       }
+      const auto data = resolveImages(component.data());
+      if(!data)
+          return false;
 
       doc.addComponent(components[component.id()]->name(),
-              components[component.id()]->object(), header + component.data());
+              components[component.id()]->object(), header + data.value());
 
       QStringList componentNames;
       for(const auto& id : component.components()) {
@@ -751,168 +1261,26 @@ bool FigmaQml::writeComponents(FigmaDocument& doc, const FigmaParser::Components
       }
 
       Q_ASSERT(c->name().endsWith(FIGMA_SUFFIX));
-      QSaveFile componentFile(m_targetDir + "/" + c->name() + ".qml");
-      /*
-       if(QFile(componentFile.fileName()).exists()) {
-          emit error(toStr("File already exists", componentFile.fileName(), QString("\"%1\" \"%2\"").arg(c->name(), c->description())));
-          return false;
-      }
-      */
-      if(!componentFile.open(QIODevice::WriteOnly)) {
-          emit error(toStr("Cannot write", componentFile.fileName(), componentFile.errorString()));
-          return false;
-      }
-      componentFile.write(header + component.data());
-      componentFile.commit();
     }
     return true;
 }
-#else
-
-void FigmaQml::writeComponents(const FigmaParser::Components& components, const QString& header) {
-    const auto componentData =
-            Concurrent::mapped<FigmaParser::Components::iterator, std::function<FigmaParser::Element (const FigmaParser::Components::const_iterator::value_type &) >>
-                          (components.begin(), components.end(), [&, this](const auto& c)->FigmaParser::Element {
-
-            if(!ok || doCancel)
-                return FigmaParser::Element();
-
-             const auto component = FigmaParser::component(c->object(), m_flags, errorFunction, imageFunction, fontFunction, components);
-
-            if(component.data().isEmpty()) {
-                ok = false;
-                emit error(toStr("Invalid component", component.name()));
-                return FigmaParser::Element();
-            }
-
-            QFile componentFile(targetDir + c->name() + ".qml");
-#ifdef _DEBUG
-            if(componentFile.exists()) {
-                emit info(toStr("File updated", componentFile.fileName(), QString("\"%1\" \"%2\"").arg(c->name()).arg(c->description())));
-            }
-#endif
-            if(!componentFile.open(QIODevice::WriteOnly)) {
-                ok = false;
-                emit error(toStr("Cannot write", componentFile.fileName(), componentFile.errorString()));
-                return FigmaParser::Element();
-            }
-            componentFile.write(header + component.data());
-
-            return component;
-        });
-
-    FutureWatcher<FigmaParser::Element> watch;
-    QEventLoop loop;
-    QObject::connect(&watch, &FutureWatcher<FigmaParser::Element>::finished, &loop, &QEventLoop::quit);
-    QObject::connect(this, &FigmaQml::error, [&doCancel](){
-        doCancel = true;
-    });
-    watch.setFuture(componentData);
-    loop.exec();
-
-    if(!watch.isFinished()) {
-        watch.waitForFinished();
-        return nullptr;
-    }
-
-    if(!ok || doCancel)
-        return nullptr;
-
-    const std::function<void (const FigmaParser::Element& c)> addComponent = [&](const FigmaParser::Element& c) { //recursive lambdas cannot be declared auto
-        if(!ok || doCancel)
-            return;
-        const auto name = components[c.id()]->name();
-        if(doc->containsComponent(name))
-            return;
-        QStringList componentNames;
-        doc->addComponent(name, components[c.id()]->object(), header + c.data());
-        for(const auto& id : c.components()) {
-            if(!ok || doCancel)
-                return;
-            Q_ASSERT(components.contains(id)); //just check here
-            const auto compname = components[id]->name();
-            componentNames.append(compname);
-            const auto cit = std::find_if(componentData.begin(), componentData.end(), [&id](const auto& c){return c.id() == id;});
-            addComponent(*cit);
-        }
-        doc->setComponents(name, componentNames);
-    };
-
-    for(const auto& c : componentData) {
-        addComponent(c);
-    }
-}
-
-#endif
 
 bool FigmaQml::setDocument(FigmaDocument& doc,
                            const FigmaParser::Canvases& canvases,
                            const FigmaParser::Components& components,
                            const QByteArray& header) {
     int currentCanvas = 0;
-#ifdef NO_CONCURRENT
     int currentElement = 0;
-#else
-    std::atomic_int currentElement = 0;
-#endif
     for(const auto& c : canvases) {
         ++currentCanvas;
         currentElement = 0;
         auto canvas = doc.addCanvas(c.name());
-#ifdef NO_CONCURRENT
-        const auto elements = c.elements();
-        for(const auto& f : elements) {
-            if(m_state == State::Suspend)
-                return false;
-            if(m_doCancel)
-                return false;
-            bool hasElement = true;
-            if(!m_filter.isEmpty()) {
-                ++currentElement;
-                const auto keys = m_filter.keys();
-                if(!keys.contains(currentCanvas) || !m_filter[currentCanvas].contains(currentElement))
-                    hasElement = false;
-            }
-
-            const auto element_opt = hasElement ? FigmaParser::element(f, m_flags, *this, components) : FigmaParser::Element();
-            if(!element_opt)
-                return false;
-            const auto& element = element_opt.value();
-#else
-        auto elements = c.elements();
-        Future<FigmaParser::Element> elementData =
-        Concurrent::mapped<FigmaParser::Canvas::ElementVector::iterator, std::function<FigmaParser::Element (const FigmaParser::Canvas::ElementVector::value_type&)> > (
-        elements.begin(), elements.end(), [&, this](const auto& f) {
-            if(!ok || doCancel)
-                return FigmaParser::Element();
-            if(!m_filter.isEmpty()) {
-                const int ce = currentElement.fetch_add(1);
-                if(!m_filter.contains(currentCanvas) || !m_filter[currentCanvas].contains(ce))
-                    return FigmaParser::Element();
-            }
-            return FigmaParser::element(f, m_flags, errorFunction, imageFunction, fontFunction, components);
-
-        });
-
-        FutureWatcher<FigmaParser::Element> watch;
-        QEventLoop loop;
-        QObject::connect(&watch, &FutureWatcher<FigmaParser::Element>::finished, &loop, &QEventLoop::quit);
-        QObject::connect(this, &FigmaQml::error, [&doCancel](){
-            doCancel = true;
-        });
-        watch.setFuture(elementData);
-        loop.exec();
-
-        if(!watch.isFinished()) {
-            watch.waitForFinished();
-            return nullptr;
-        }
-
-        if(!ok || doCancel)
-            return nullptr;
-
-        for(const auto& element : elementData) {
-#endif
+        const auto count = static_cast<int>(c.elements().size());
+        for(int i = 0; i < count; ++i) {
+            ++currentElement;
+            const auto key = qMakePair(currentCanvas, currentElement);
+            Q_ASSERT(m_build->elements.contains(key));
+            const auto element = m_build->elements.value(key);
             if(m_state == State::Suspend)
                 return false;
 
@@ -921,9 +1289,12 @@ bool FigmaQml::setDocument(FigmaDocument& doc,
             if(!m_ok) {
                 return false;
             }
-            if(!element.data().isEmpty())
-                canvas->addElement(element.name(), header + element.data());
-            else
+            if(!element.data().isEmpty()) {
+                const auto data = resolveImages(element.data());
+                if(!data)
+                    return false;
+                canvas->addElement(element.name(), header + data.value());
+            } else
                 canvas->addElement(element.name(), header + "Text{text: \"filtered out\"}");
             QStringList componentNames;
             for(const auto& id : element.components()) {
@@ -968,32 +1339,21 @@ bool FigmaQml::doCreateDocument(FigmaDocument& doc, const QJsonObject& json) {
 #endif
     }
 
-    const auto components = FigmaParser::components(json, *this);
-
-    if(!components) {
-        return false;
-    }
-
-     TIMED_START(t3)
-
-    /*
-    const auto keys = components->keys();
-    for (const auto k : keys) {
-        qDebug().nospace()
-                << k << ';'
-                << (*components)[k]->id() << ';'
-                << (*components)[k]->key() << ';'
-                << (*components)[k]->name();
+    if(!m_build->components) {
+        auto components = FigmaParser::components(json, m_build->parsed->index, *this);
+        if(!components) {
+            return false;
+        }
+        if(m_flags & ExtractRepeated)
+            FigmaParser::extractRepeated(json["document"].toObject(), *components);
+        m_build->components = components;
     }
 
+    const auto& components = m_build->components.value();
 
-    static int loopers = 0;
-    ++loopers;
-    const auto [i, r, n] = mProvider.cacheInfo();
-    qDebug() << "loopers" << loopers << i << r << n;
-    */
+     TIMED_START(t3)
 
-    if(!writeComponents(doc, *components, header)) {
+    if(!parseComponents(components)) {
         return false;
     }
 
@@ -1005,11 +1365,23 @@ bool FigmaQml::doCreateDocument(FigmaDocument& doc, const QJsonObject& json) {
     if(!canvases)
         return false;
 
-    if(!setDocument(doc, *canvases, *components, header)) {
+    if(!parseElements(*canvases, components)) {
         return false;
     }
 
     TIMED_END(t4, "elements")
+
+    if(m_state == State::Suspend)
+        return false; // resumed when the pending resources are received
+
+    if(!writeComponents(doc, components, header)) {
+        return false;
+    }
+
+    if(!setDocument(doc, *canvases, components, header)) {
+        return false;
+    }
+
     return true;
 }
 
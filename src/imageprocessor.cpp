@@ -0,0 +1,60 @@
+#include "imageprocessor.h"
+#include <QImageReader>
+#include <QImageWriter>
+#include <QBuffer>
+
+ImageProcessor::ImageProcessor(QObject* parent) : QObject(parent) {
+}
+
+ImageProcessor::~ImageProcessor() {
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+void ImageProcessor::process(const QByteArray& bytes, const QSize& maxSize, const ReadyFunction& ready) {
+    ++m_pending;
+    const auto task = [this, bytes, maxSize, ready]() {
+        const auto image = processImage(bytes, maxSize);
+        QMetaObject::invokeMethod(this, [this, image, ready]() {
+            --m_pending;
+            ready(image);
+        }, Qt::QueuedConnection);
+    };
+#if QT_CONFIG(thread)
+    m_pool.start(task);
+#else
+    task();
+#endif
+}
+
+ImageProcessor::Image ImageProcessor::processImage(QByteArray bytes, const QSize& maxSize) {
+    QBuffer imageBuffer(&bytes);
+    QImageReader imageReader(&imageBuffer);
+    const auto format = imageReader.format();
+    if(!(format == "png" || format == "jpeg" || format == "jpg"))
+        return {{}, format, QString("format not supported \"%1\"").arg(QString(format))};
+
+    const auto size = imageReader.size();
+    if(size.isValid() && size.width() <= maxSize.width() && size.height() <= maxSize.height())
+        return {bytes, format, {}};
+
+    // decoder scales while reading, e.g. JPEG is never decoded at full size
+    if(size.isValid())
+        imageReader.setScaledSize(size.scaled(maxSize, Qt::KeepAspectRatio));
+    auto image = imageReader.read();
+    if(!size.isValid()) {
+        if(!image.isNull() && image.width() <= maxSize.width() && image.height() <= maxSize.height())
+            return {bytes, format, {}};
+        image = image.scaled(maxSize, Qt::KeepAspectRatio);
+    }
+    if(image.isNull())
+        return {{}, format, QString("cannot be resized to %1x%2").arg(maxSize.width()).arg(maxSize.height())};
+
+    QByteArray scaled;
+    QBuffer buffer(&scaled);
+    buffer.open(QIODevice::WriteOnly);
+    QImageWriter writer(&buffer, format);
+    if(!writer.write(image))
+        return {{}, format, QString("cannot be resized %1").arg(writer.errorString())};
+    return {scaled, format, {}};
+}
@@ -4,6 +4,7 @@
 #include "downloads.h"
 #include "functorslot.h"
 #include "figmadata.h"
+#include "qmlserver.h"
 #include <QApplication>
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
@@ -73,7 +74,8 @@ static QVector<QPair<QString, QString>> parseFontMap(const QString& str, bool us
 enum {
     CmdLine = 1,
     Store = 2,
-    ShowFonts = 4
+    ShowFonts = 4,
+    Zip = 8
 };
 
 
@@ -93,12 +95,15 @@ int main(int argc, char *argv[]) {
     const QCommandLineOption renderFrameParameter("render-frame", "Render frames as images.");
     const QCommandLineOption imageDimensionMaxParameter("image-dimension-max", "Capping an image size, default is 1024.", "imageDimensionMax");
     const QCommandLineOption embedImagesParameter("embed-images", "Embed images into QML files.");
+    const QCommandLineOption resourceImagesParameter("resource-images", "Refer images as qrc:/ URLs and write an images.qrc resource file for them.");
     const QCommandLineOption breakBooleansParameter("break-boolean", "Break Figma boolean shapes to QtQuick items.");
     const QCommandLineOption antializeShapesParameter("antialize-shapes", "Add antialiaze property to shapes.");
     const QCommandLineOption importsParameter("imports", "QML imports, ';' separated list of imported modules as <module-name> <version-number>.", "imports");
     const QCommandLineOption snapParameter("snap", "Take snapshot and exit, expects restore or user project token parameters to be given.", "snapFile");
     const QCommandLineOption storeParameter("store", "Create .figmaqml file and exit, expects user and project token parameters to be given.");
     const QCommandLineOption timedParameter("timed", "Time parsing process.");
+    const QCommandLineOption zipParameter("zip", "Write the output into a zip file instead of a directory.");
+    const QCommandLineOption extractRepeatedParameter("extract-repeated", "Generate components of groups and frames copied at least three times, the copies may differ only in their position.");
     const QCommandLineOption figmaFontParameter("keepFigmaFont", "Do not resolve fonts, keep original font names.");
     const QCommandLineOption showFontsParameter("show-fonts", "Show the font mapping.");
     const QCommandLineOption fontFolderParameter("font-folder", "Add an additional path to search fonts.", "fontFolder");
@@ -106,6 +111,8 @@ int main(int argc, char *argv[]) {
     const QCommandLineOption altFontMatchParameter("alt-font-match", "Use alternative font matching algorithm.");
     const QCommandLineOption fontMapParameter("font-map", "Provide a ';' separated list of <figma font>':'<system font> pairs.", "fontMap");
     const QCommandLineOption throttleParameter("throttle", "Milliseconds between server requests. Too frequent request may have issues, especially with big desings - default 300", "throttle");
+    const QCommandLineOption concurrencyParameter("concurrency", "Maximum number of simultaneous image downloads - default 8", "concurrency");
+    const QCommandLineOption imageCacheParameter("image-cache", "Directory of images cached over runs, empty disables - default is in the user cache directory", "imageCache");
 
     parser.addPositionalArgument("argument 1", "Optional: .figmaqml file or user token. GUI opened if empty.", "<FIGMAQML_FILE>|<USER_TOKEN>");
     parser.addPositionalArgument("argument 2", "Optional: Output directory name (or .figmaqml file name if '--store' is given), assuming the first parameter was the restored file. If empty, GUI is opened. Project token is expected if the first parameter was an user token.", "<OUTPUT if FIGMAQML_FILE>| PROJECT_TOKEN if USER_TOKEN");
@@ -117,16 +124,21 @@ int main(int argc, char *argv[]) {
                           breakBooleansParameter,
                           antializeShapesParameter,
                           embedImagesParameter,
+                          resourceImagesParameter,
                           importsParameter,
                           snapParameter,
                           storeParameter,
                           timedParameter,
+                          extractRepeatedParameter,
+                          zipParameter,
                           showParameter,
                           showFontsParameter,
                           fontFolderParameter,
                           altFontMatchParameter,
                           fontMapParameter,
                           throttleParameter,
+                          concurrencyParameter,
+                          imageCacheParameter,
                           figmaFontParameter
                       });
 
@@ -177,6 +189,9 @@ int main(int argc, char *argv[]) {
     if(parser.isSet(showFontsParameter))
         state |= ShowFonts;
 
+    if(parser.isSet(zipParameter))
+        state |= Zip;
+
     if(!snapFile.isEmpty() && !(userToken.isEmpty() || restore.isEmpty())) {
         parser.showHelp(-2);
     }
@@ -224,7 +239,9 @@ int main(int argc, char *argv[]) {
     auto figmaGet = std::make_unique<FigmaGet>();
     auto figmaQml = std::make_unique<FigmaQml>(dir.path(), fontFolder, *figmaGet);
 
+    QmlServer::Factory qmlServer; // outlives the engine
     QQmlApplicationEngine engine;
+    engine.setNetworkAccessManagerFactory(&qmlServer);
     Clipboard clipboard;
    // figmaQml->setFilter({{1,{2}}});
 
@@ -247,10 +264,14 @@ int main(int argc, char *argv[]) {
                 qmlFlags |= FigmaQml::AntializeShapes;
             if(parser.isSet(embedImagesParameter))
                 qmlFlags |= FigmaQml::EmbedImages;
+            if(parser.isSet(resourceImagesParameter))
+                qmlFlags |= FigmaQml::ResourceImages;
             if(parser.isSet(altFontMatchParameter))
                 qmlFlags |= FigmaQml::AltFontMatch;
             if(parser.isSet(figmaFontParameter))
                 qmlFlags |= FigmaQml::KeepFigmaFontName;
+            if(parser.isSet(extractRepeatedParameter))
+                qmlFlags |= FigmaQml::ExtractRepeated;
 
             if(parser.isSet(importsParameter)) {
                 QMap<QString, QVariant> imports;
@@ -290,6 +311,12 @@ int main(int argc, char *argv[]) {
 
          if(parser.isSet(throttleParameter))
             figmaGet->setProperty("throttle", parser.value(throttleParameter));
+
+         if(parser.isSet(concurrencyParameter))
+            figmaGet->setProperty("concurrency", parser.value(concurrencyParameter));
+
+         if(parser.isSet(imageCacheParameter))
+            figmaGet->setProperty("imageCache", parser.value(imageCacheParameter));
      }
 
 
@@ -345,6 +372,14 @@ int main(int argc, char *argv[]) {
                          ::print() << "\nStore to " << saveName << " failed" << Qt::endl;
                           excode = -1;
                          }
+                 } else if(!output.isEmpty() && (state & Zip)) {
+                    const auto zipName = output.endsWith(".zip") ? output : output + ".zip";
+                    if(figmaQml->saveAllQMLZip(zipName)) {
+                        ::print() << "\nSaved to " << zipName << Qt::endl;
+                    } else {
+                        ::print() << "\nSave to " << zipName << " failed" << Qt::endl;
+                        excode = -1;
+                    }
                  } else if(!output.isEmpty()) {
                     if(figmaQml->saveAllQML(output)) {
                         ::print() << "\nSaved to " << output << Qt::endl;
@@ -523,6 +558,12 @@ int main(int argc, char *argv[]) {
 #else
           false);
 #endif
+         engine.rootContext()->setContextProperty("hasZipExport",
+#ifdef HAS_QUAZIP
+          true);
+#else
+          false);
+#endif
 
          QObject::connect(figmaQml.get(), &FigmaQml::elementChanged, [&engine](){
              engine.clearComponentCache();
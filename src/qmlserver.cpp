@@ -0,0 +1,136 @@
+#include "qmlserver.h"
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QHash>
+#include <QStringList>
+#include <atomic>
+#include <cstring>
+#include <algorithm>
+
+namespace {
+
+struct Root {
+    QHash<QString, QByteArray> files;
+    QStringList types;
+};
+
+// the engine may create access managers and load components in its loader thread
+QMutex mutex;
+QHash<QString, Root> roots;
+std::atomic_int rootCount = 0;
+
+class MemoryReply : public QNetworkReply {
+public:
+    MemoryReply(const QNetworkRequest& request, const std::optional<QByteArray>& data, QObject* parent) : QNetworkReply(parent) {
+        setRequest(request);
+        setUrl(request.url());
+        setOperation(QNetworkAccessManager::GetOperation);
+        open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+        if(data) {
+            m_data = *data;
+            setHeader(QNetworkRequest::ContentTypeHeader, QByteArray("text/plain"));
+            setHeader(QNetworkRequest::ContentLengthHeader, m_data.size());
+            setAttribute(QNetworkRequest::HttpStatusCodeAttribute, 200);
+            setFinished(true);
+            QMetaObject::invokeMethod(this, [this]() {
+                emit metaDataChanged();
+                emit readyRead();
+                emit finished();
+            }, Qt::QueuedConnection);
+        } else {
+            setError(ContentNotFoundError, QString("Not found %1").arg(request.url().toString()));
+            setFinished(true);
+            QMetaObject::invokeMethod(this, [this]() {
+                emit errorOccurred(ContentNotFoundError);
+                emit finished();
+            }, Qt::QueuedConnection);
+        }
+    }
+    void abort() override {}
+    bool isSequential() const override {return true;}
+    qint64 bytesAvailable() const override {
+        return m_data.size() - m_pos + QNetworkReply::bytesAvailable();
+    }
+protected:
+    qint64 readData(char* data, qint64 maxSize) override {
+        const auto size = std::min(maxSize, static_cast<qint64>(m_data.size() - m_pos));
+        if(size <= 0)
+            return -1;
+        std::memcpy(data, m_data.constData() + m_pos, size);
+        m_pos += size;
+        return size;
+    }
+private:
+    QByteArray m_data;
+    qint64 m_pos = 0;
+};
+
+class AccessManager : public QNetworkAccessManager {
+public:
+    explicit AccessManager(QObject* parent) : QNetworkAccessManager(parent) {}
+protected:
+    QNetworkReply* createRequest(Operation op, const QNetworkRequest& request, QIODevice* outgoingData) override {
+        if(request.url().scheme() != QmlServer::Scheme)
+            return QNetworkAccessManager::createRequest(op, request, outgoingData);
+        return new MemoryReply(request, op == GetOperation ? QmlServer::file(request.url()) : std::nullopt, this);
+    }
+};
+
+}
+
+QNetworkAccessManager* QmlServer::Factory::create(QObject* parent) {
+    return new AccessManager(parent);
+}
+
+QString QmlServer::addRoot() {
+    const auto root = QString("doc%1").arg(++rootCount);
+    QMutexLocker lock(&mutex);
+    roots.insert(root, {});
+    return root;
+}
+
+void QmlServer::removeRoot(const QString& root) {
+    QMutexLocker lock(&mutex);
+    roots.remove(root);
+}
+
+void QmlServer::addFile(const QString& root, const QString& name, const QByteArray& data) {
+    QMutexLocker lock(&mutex);
+    roots[root].files.insert(name + ".qml", data);
+}
+
+void QmlServer::addType(const QString& root, const QString& name, const QByteArray& data) {
+    QMutexLocker lock(&mutex);
+    auto& r = roots[root];
+    if(!r.files.contains(name + ".qml"))
+        r.types.append(name);
+    r.files.insert(name + ".qml", data);
+}
+
+QUrl QmlServer::url(const QString& root, const QString& name) {
+    QUrl url;
+    url.setScheme(Scheme);
+    url.setHost(root);
+    url.setPath('/' + name + ".qml");
+    return url;
+}
+
+std::optional<QByteArray> QmlServer::file(const QUrl& url) {
+    QMutexLocker lock(&mutex);
+    const auto it = roots.find(url.host());
+    if(it == roots.end())
+        return std::nullopt;
+    const auto name = url.path().mid(1);
+    if(name == "qmldir") {
+        QByteArray qmldir;
+        for(const auto& type : qAsConst(it->types))
+            qmldir += QString("%1 1.0 %1.qml\n").arg(type).toUtf8();
+        return qmldir;
+    }
+    const auto file = it->files.find(name);
+    if(file == it->files.end())
+        return std::nullopt;
+    return file.value();
+}
@@ -1,30 +1,24 @@
 #include "figmaqml.h"
-#include <QTemporaryDir>
 #include <QFileDialog>
 #include <QFontDatabase>
-#include <quazip/JlCompress.h>
+#include <QBuffer>
 
 
 bool FigmaQml::saveAllQMLZipped(const QString& docName, const QString& canvasName) {
-    QTemporaryDir temp;
-    if(!saveAllQML(temp.path())) {
-        qDebug() << "Failded to save" << temp.path();
-        return false;
-    }
-     const auto temp_name = QString::fromLatin1(std::tmpnam(nullptr), -1);
-     if(!JlCompress::compressDir(temp_name, temp.path())) {
-          qDebug() << "Failded to compress" << temp_name << "of" << temp.path();
-         return  false;
-     }
-     QFile dump(temp_name);
-     if(!dump.open(QIODevice::ReadOnly)) {
-         qDebug() << "Cannot open" << temp_name;
+     const auto zipName = docName + "_" + canvasName + ".zip";
+#ifndef HAS_QUAZIP
+     emit error(QString("Cannot write %1, zip export is not built in").arg(zipName));
+     return false;
+#else
+     QBuffer buffer;
+     buffer.open(QIODevice::WriteOnly);
+     if(!writeZip(buffer, zipName)) {
+         qDebug() << "Failded to compress" << zipName;
          return false;
      }
-     const auto data = dump.readAll();
-     const auto zipName = docName + "_" + canvasName + ".zip";
-     QFileDialog::saveFileContent(data, zipName);
+     QFileDialog::saveFileContent(buffer.data(), zipName);
      return true;
+#endif
 }
 
 bool FigmaQml::importFontFolder() {
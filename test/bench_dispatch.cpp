@@ -0,0 +1,86 @@
+#include "figmaparser.h"
+#include <QTest>
+#include <functional>
+
+// Cost of finding the parse function of a node: the hash of std::bind wrappers
+// parse used to build for every node, against the static table it uses now.
+class BenchDispatch : public QObject {
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void hashOfBinds();
+    void staticTable();
+private:
+    int parse(const QJsonObject&, int intendents) {return intendents;}
+private:
+    std::vector<QJsonObject> m_nodes;
+};
+
+constexpr auto Nodes = 1000; // an iteration dispatches this many nodes
+
+void BenchDispatch::initTestCase() {
+    const QStringList types {"RECTANGLE", "TEXT", "COMPONENT", "BOOLEAN_OPERATION", "INSTANCE", "ELLIPSE",
+                             "VECTOR", "LINE", "REGULAR_POLYGON", "STAR", "GROUP", "FRAME", "COMPONENT_SET",
+                             "SLICE", "STAMP", "STICKY", "SHAPE_WITH_TEXT", "NONE"};
+    for(int i = 0; i < Nodes; ++i)
+        m_nodes.push_back(QJsonObject{{"type", types[i % types.size()]}});
+}
+
+void BenchDispatch::hashOfBinds() {
+    using namespace std::placeholders;
+    int count = 0;
+    QBENCHMARK {
+        for(const auto& obj : m_nodes) {
+            const auto type = obj["type"].toString();
+            const QHash<QString, std::function<int (const QJsonObject&, int)>> parsers {
+                {"RECTANGLE", std::bind(&BenchDispatch::parse, this, _1, _2)},
+                {"TEXT", std::bind(&BenchDispatch::parse, this, _1, _2)},
+                {"COMPONENT", std::bind(&BenchDispatch::parse, this, _1, _2)},
+                {"BOOLEAN_OPERATION", std::bind(&BenchDispatch::parse, this, _1, _2)},
+                {"INSTANCE", std::bind(&BenchDispatch::parse, this, _1, _2)},
+                {"ELLIPSE", std::bind(&BenchDispatch::parse, this, _1, _2)},
+                {"VECTOR", std::bind(&BenchDispatch::parse, this, _1, _2)},
+                {"LINE", std::bind(&BenchDispatch::parse, this, _1, _2)},
+                {"REGULAR_POLYGON", std::bind(&BenchDispatch::parse, this, _1, _2)},
+                {"STAR", std::bind(&BenchDispatch::parse, this, _1, _2)},
+                {"GROUP", std::bind(&BenchDispatch::parse, this, _1, _2)},
+                {"FRAME", std::bind(&BenchDispatch::parse, this, _1, _2)},
+                {"COMPONENT_SET", std::bind(&BenchDispatch::parse, this, _1, _2)},
+                {"SLICE", std::bind(&BenchDispatch::parse, this, _1, _2)},
+                {"STAMP", std::bind(&BenchDispatch::parse, this, _1, _2)},
+                {"STICKY", std::bind(&BenchDispatch::parse, this, _1, _2)},
+                {"SHAPE_WITH_TEXT", std::bind(&BenchDispatch::parse, this, _1, _2)},
+                {"NONE", [this](const QJsonObject& o, int i){return parse(o, i);}}
+            };
+            if(parsers.contains(type))
+                count += parsers[type](obj, 1);
+        }
+    }
+    QVERIFY(count >= Nodes);
+}
+
+void BenchDispatch::staticTable() {
+    using NodeType = FigmaParser::NodeType;
+    int count = 0;
+    QBENCHMARK {
+        for(const auto& obj : m_nodes) {
+            const auto type = FigmaParser::nodeType(obj);
+            if(!type)
+                continue;
+            switch(*type) {
+            case NodeType::Vector: count += parse(obj, 1); break;
+            case NodeType::Text: count += parse(obj, 1); break;
+            case NodeType::Component: count += parse(obj, 1); break;
+            case NodeType::Boolean: count += parse(obj, 1); break;
+            case NodeType::Instance: count += parse(obj, 1); break;
+            case NodeType::Frame: count += parse(obj, 1); break;
+            case NodeType::Skip: count += parse(obj, 1); break;
+            case NodeType::Plain: count += parse(obj, 1); break;
+            }
+        }
+    }
+    QVERIFY(count >= Nodes);
+}
+
+QTEST_GUILESS_MAIN(BenchDispatch)
+#include "bench_dispatch.moc"
@@ -0,0 +1,91 @@
+#!/usr/bin/env bash
+if [ -z "${PYTHON_3}" ]; then
+    PYTHON_3="python3"
+fi
+
+if ! command -v ${PYTHON_3} &> /dev/null; then
+    echo Python: "${PYTHON_3}", not found
+    exit -888
+fi
+
+if [ -z "${FILE_NAME}" ]; then
+    FILE_NAME="fq_snapshot";
+fi
+
+LOCAL_DIR="$(dirname "$(realpath "$0")")"
+
+if [ -z "$2" ]; then
+    DOCUMENT=${LOCAL_DIR}/document.json
+else
+    DOCUMENT=$2
+fi
+
+export QT_QPA_PLATFORM=offscreen
+
+echo Test: Snapshot
+echo Params: ${DOCUMENT}
+
+echo Phase 1: Write a FQ03 snapshot of the document.
+
+rm -f ${FILE_NAME}_fq03.figmaqml
+${PYTHON_3} ${LOCAL_DIR}/snapshot.py ${DOCUMENT} ${FILE_NAME}_fq03.figmaqml
+
+if [ $? -ne 0 ]; then
+    echo Error: code $?
+    exit -70
+fi
+
+echo Phase 2: Generate QML from the FQ03 snapshot.
+
+rm -rf ${FILE_NAME}_fq03_qml
+$1 ${FILE_NAME}_fq03.figmaqml ${FILE_NAME}_fq03_qml
+
+if [ $? -ne 0 ] || [ ! -d ${FILE_NAME}_fq03_qml ]; then
+    echo Error: ${FILE_NAME}_fq03_qml not generated
+    exit -71
+fi
+
+echo Phase 3: Store the restored FQ03 snapshot as FQ04.
+
+rm -f ${FILE_NAME}_fq04.figmaqml
+$1 --store ${FILE_NAME}_fq03.figmaqml ${FILE_NAME}_fq04.figmaqml
+
+if [ $? -ne 0 ] || [ ! -f ${FILE_NAME}_fq04.figmaqml ]; then
+    echo Error: ${FILE_NAME}_fq04.figmaqml not stored
+    exit -72
+fi
+
+if [ "$(head -c 12 ${FILE_NAME}_fq04.figmaqml | tail -c 8 | iconv -f UTF-16BE -t UTF-8)" != "FQ04" ]; then
+    echo Error: ${FILE_NAME}_fq04.figmaqml is not FQ04
+    exit -73
+fi
+
+echo Phase 4: Store the restored FQ04 snapshot again, lazy entries are read from the restored file.
+
+rm -f ${FILE_NAME}_fq04_2.figmaqml
+$1 --store ${FILE_NAME}_fq04.figmaqml ${FILE_NAME}_fq04_2.figmaqml
+
+if [ $? -ne 0 ] || [ ! -f ${FILE_NAME}_fq04_2.figmaqml ]; then
+    echo Error: ${FILE_NAME}_fq04_2.figmaqml not stored
+    exit -74
+fi
+
+echo Phase 5: Generate QML from the FQ04 snapshot and compare.
+
+rm -rf ${FILE_NAME}_fq04_qml
+$1 ${FILE_NAME}_fq04_2.figmaqml ${FILE_NAME}_fq04_qml
+
+if [ $? -ne 0 ] || [ ! -d ${FILE_NAME}_fq04_qml ]; then
+    echo Error: ${FILE_NAME}_fq04_qml not generated
+    exit -75
+fi
+
+TEST=$(diff -r ${FILE_NAME}_fq03_qml ${FILE_NAME}_fq04_qml)
+
+if [[ $TEST ]]; then
+    echo Error: "$TEST"
+    echo Result: fail
+    exit -170
+else
+    echo Result: ok
+fi
@@ -0,0 +1,38 @@
+import sys
+import os
+import json
+import struct
+
+# Writes a legacy FQ03 .figmaqml snapshot of a Figma document JSON, as QDataStream would
+
+
+def qstring(s):
+    data = s.encode('utf-16-be')
+    return struct.pack('>I', len(data)) + data
+
+
+def qbytearray(b):
+    return struct.pack('>I', len(b)) + b
+
+
+def quint32(v):
+    return struct.pack('>I', v)
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 3:
+        print("<document.json> <snapshot.figmaqml>")
+        exit(0)
+    with open(sys.argv[1], 'rb') as f:
+        data = f.read()
+    json.loads(data)  # fails on an invalid document
+    out = qstring('FQ03')
+    out += qstring(os.path.splitext(os.path.basename(sys.argv[1]))[0])  # project token
+    out += qbytearray(data)
+    out += quint32(0)  # checksum
+    out += quint32(0)  # flags
+    out += quint32(0)  # imports
+    for _ in range(3):  # images, renderings and nodes
+        out += quint32(0)
+    with open(sys.argv[2], 'wb') as f:
+        f.write(out)
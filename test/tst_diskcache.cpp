@@ -0,0 +1,70 @@
+#include "diskcache.h"
+#include <QTest>
+#include <QTemporaryDir>
+#include <QDir>
+#include <QFile>
+#include <QDateTime>
+
+class TestDiskCache : public QObject {
+    Q_OBJECT
+private slots:
+    void readWrite();
+    void evictLeastRecentlyUsed();
+    void overwrite();
+private:
+    static void age(const QString& directory);
+};
+
+constexpr auto Size = QSize(100, 100);
+
+// entries get older by a minute, so the test does not depend on the file time resolution
+void TestDiskCache::age(const QString& directory) {
+    const auto entries = QDir(directory).entryInfoList(QDir::Files);
+    for(const auto& e : entries) {
+        QFile file(e.absoluteFilePath());
+        QVERIFY(file.open(QIODevice::Append));
+        QVERIFY(file.setFileTime(e.lastModified().addSecs(-60), QFileDevice::FileModificationTime));
+    }
+}
+
+void TestDiskCache::readWrite() {
+    QTemporaryDir dir;
+    DiskCache cache(dir.path());
+    QVERIFY(!cache.read("a", Size));
+    cache.write("a", Size, "image");
+    QCOMPARE(cache.read("a", Size).value(), QByteArray("image"));
+    QVERIFY(!cache.read("a", QSize(200, 200))); // size is part of the key
+}
+
+void TestDiskCache::evictLeastRecentlyUsed() {
+    QTemporaryDir dir;
+    DiskCache cache(dir.path(), 1000);
+    const QByteArray bytes(300, 'x');
+    for(const auto& ref : {"a", "b", "c"}) {
+        cache.write(ref, Size, bytes);
+        age(dir.path());
+    }
+    QVERIFY(cache.read("a", Size)); // "a" is the most recently used now
+    cache.write("d", Size, bytes); // over the maximum, evicted down to 3/4 of it
+    QVERIFY(cache.read("a", Size));
+    QVERIFY(!cache.read("b", Size));
+    QVERIFY(!cache.read("c", Size));
+    QVERIFY(cache.read("d", Size));
+}
+
+void TestDiskCache::overwrite() {
+    QTemporaryDir dir;
+    DiskCache cache(dir.path(), 1000);
+    const QByteArray bytes(300, 'x');
+    for(const auto& ref : {"a", "b", "c"}) {
+        cache.write(ref, Size, bytes);
+        age(dir.path());
+    }
+    cache.write("c", Size, bytes); // replaced entry is not counted twice
+    QVERIFY(cache.read("a", Size));
+    QVERIFY(cache.read("b", Size));
+    QVERIFY(cache.read("c", Size));
+}
+
+QTEST_GUILESS_MAIN(TestDiskCache)
+#include "tst_diskcache.moc"
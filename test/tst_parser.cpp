@@ -0,0 +1,106 @@
+#include "figmaparser.h"
+#include "figmaprovider.h"
+#include <QTest>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QFile>
+
+// parser data without images or nodes, fonts resolve to themselves
+class Data : public FigmaParserData {
+public:
+    void parseError(const QString& error, bool) override {errors.append(error);}
+    QByteArray imageData(const QString&, bool) override {return {};}
+    QByteArray nodeData(const QString&) override {return {};}
+    QString fontInfo(const QString& family) override {return family;}
+    QStringList errors;
+};
+
+class TestParser : public QObject {
+    Q_OBJECT
+private slots:
+    void hostileNames();
+    void extractRepeated();
+};
+
+// a name or text can contain anything, also the image reference markers
+static const QString Hostile = QString("x\"\n}\nItem {\\\t") + QChar(0x01) + "Ievil" + QChar(0x02) + "\"";
+
+static QJsonObject node(const QString& id, const QString& type, const QString& name) {
+    return QJsonObject {
+        {"id", id},
+        {"name", name},
+        {"type", type},
+        {"absoluteBoundingBox", QJsonObject{{"x", 0}, {"y", 0}, {"width", 100}, {"height", 50}}},
+        {"relativeTransform", QJsonArray{QJsonArray{1, 0, 0}, QJsonArray{0, 1, 0}}},
+        {"size", QJsonObject{{"x", 100}, {"y", 50}}},
+        {"fills", QJsonArray{QJsonObject{{"type", "SOLID"}, {"color", QJsonObject{{"r", 0}, {"g", 0}, {"b", 0}, {"a", 1}}}}}},
+        {"strokes", QJsonArray()},
+        {"strokeWeight", 1},
+        {"strokeAlign", "INSIDE"},
+        {"effects", QJsonArray()}
+    };
+}
+
+void TestParser::hostileNames() {
+    auto text = node("1:3", "TEXT", Hostile);
+    text.insert("characters", Hostile);
+    text.insert("style", QJsonObject {
+        {"fontFamily", Hostile},
+        {"fontWeight", 400},
+        {"fontSize", 14},
+        {"textAlignHorizontal", "LEFT"},
+        {"textAlignVertical", "TOP"},
+        {"letterSpacing", 0},
+        {"lineHeightPx", 16}});
+    auto frame = node("1:1", "FRAME", Hostile);
+    frame.insert("children", QJsonArray{node("1:2", "RECTANGLE", Hostile), text});
+
+    Data data;
+    const FigmaParser::Index index(frame);
+    const auto element = FigmaParser::element(frame, 0, data, {}, index);
+    QVERIFY2(element, qPrintable(FigmaParser::lastError()));
+    const auto qml = element->data();
+
+    QVERIFY(!qml.contains('\x01'));
+    QVERIFY(!qml.contains('\x02'));
+    QVERIFY(!qml.contains("}\nItem {\\"));
+    const QByteArray escaped = "x\\\"\\n}\\nItem {\\\\\\t\\u0001Ievil\\u0002\\\"";
+    QVERIFY(qml.count("objectName:\"" + escaped + "\"\n") >= 3); // frame, rectangle and text
+    QVERIFY(qml.contains("text:\"" + escaped + "\"\n"));
+    QVERIFY(qml.contains("\"" + escaped + "\"")); // font family
+    // every quote left unescaped opens or closes a literal, so they pair up within a line
+    for(const auto& line : qml.split('\n')) {
+        int quotes = 0;
+        for(int i = 0; i < line.size(); ++i) {
+            if(line[i] == '\\')
+                ++i;
+            else if(line[i] == '"')
+                ++quotes;
+        }
+        QVERIFY2(quotes % 2 == 0, line.constData());
+    }
+}
+
+// the fixture has three cards that differ only in their position, a pair of copies
+// and a card of another size
+void TestParser::extractRepeated() {
+    QFile file(QFINDTESTDATA("repeated.json"));
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const auto project = QJsonDocument::fromJson(file.readAll()).object();
+    FigmaParser::Components components;
+    FigmaParser::extractRepeated(project["document"].toObject(), components);
+
+    QCOMPARE(components.size(), 3);
+    const auto component = components.value("1:0");
+    QVERIFY(component);
+    QCOMPARE(component->name(), FigmaParser::makeFileName(QString("Card_repeated") + FIGMA_SUFFIX));
+    QVERIFY(components.value("2:0") == component);
+    QVERIFY(components.value("3:0") == component);
+    QVERIFY(!components.contains("4:0")); // two copies are not enough
+    QVERIFY(!components.contains("5:0"));
+    QVERIFY(!components.contains("6:0")); // the size must match
+}
+
+QTEST_GUILESS_MAIN(TestParser)
+#include "tst_parser.moc"
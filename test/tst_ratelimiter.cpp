@@ -0,0 +1,56 @@
+#include "ratelimiter.h"
+#include <QTest>
+
+class TestRateLimiter : public QObject {
+    Q_OBJECT
+private slots:
+    void burst();
+    void retryAfter();
+    void backoff();
+    void limit();
+};
+
+void TestRateLimiter::burst() {
+    RateLimiter limiter(0.1, 3.); // no token is refilled during the test
+    QVERIFY(limiter.tryAcquire());
+    QVERIFY(limiter.tryAcquire());
+    QVERIFY(limiter.tryAcquire());
+    QVERIFY(!limiter.tryAcquire());
+}
+
+void TestRateLimiter::retryAfter() {
+    RateLimiter limiter(100.);
+    const auto wait = limiter.tooManyRequests(100);
+    QVERIFY(wait >= 100 && wait <= 125);
+    QCOMPARE(limiter.rate(), 50.);
+    QVERIFY(!limiter.tryAcquire());
+    QTRY_VERIFY_WITH_TIMEOUT(limiter.tryAcquire(), 1000);
+    limiter.success();
+    QVERIFY(limiter.rate() > 50.);
+}
+
+void TestRateLimiter::backoff() {
+    Backoff backoff;
+    const auto first = backoff.tooManyRequests(-1);
+    QVERIFY(first >= 2000 && first <= 2500);
+    const auto second = backoff.tooManyRequests(-1);
+    QVERIFY(second >= 4000 && second <= 5000);
+    QVERIFY(backoff.remaining() > 0);
+    for(int i = 0; i < 10; ++i)
+        QVERIFY(backoff.tooManyRequests(-1) <= 60 * 1000 * 5 / 4);
+    backoff.success();
+    const auto reset = backoff.tooManyRequests(-1);
+    QVERIFY(reset >= 2000 && reset <= 2500);
+}
+
+void TestRateLimiter::limit() {
+    RateLimiter limiter(10.);
+    limiter.limit(5, 1000);
+    QCOMPARE(limiter.rate(), 5.);
+    limiter.limit(0, 100); // window is used up
+    QVERIFY(!limiter.tryAcquire());
+    QTRY_VERIFY_WITH_TIMEOUT(limiter.tryAcquire(), 1000);
+}
+
+QTEST_GUILESS_MAIN(TestRateLimiter)
+#include "tst_ratelimiter.moc"